@@ -6,7 +6,568 @@
 #include <vector>
 #include <ctime>
 #include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+#include <future>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <set>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string_view>
+#include <charconv>
 using namespace std;
+// -------------------- Logging --------------------
+// Diagnostics from business logic go through the LOG_* macros rather than
+// cout. Calls below LOG_MIN_LEVEL are compiled out and never evaluate their
+// arguments. An enabled call copies the format pointer and its arguments
+// into a fixed-size binary record on a lock-free ring; a background thread
+// turns records into text ("{}" takes the next argument) and writes them to
+// the sink. When the ring is full the record is dropped and counted rather
+// than blocking the caller.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1   // 0 debug, 1 info, 2 warn, 3 error, 4 off
+#endif
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error, Off };
+
+class Logger {
+private:
+    enum ArgType : uint8_t { ArgInt, ArgUnsigned, ArgDouble, ArgText };
+    static const size_t MAX_ARGS = 8;
+    static const size_t PAYLOAD = 208;
+
+    struct alignas(64) Record {
+        atomic<size_t> sequence;
+        int64_t time_us;
+        const char* format;   // a string literal, so the pointer stays valid
+        LogLevel level;
+        uint8_t argc;
+        uint8_t types[MAX_ARGS];
+        uint8_t used;
+        char payload[PAYLOAD];
+    };
+
+    vector<Record> ring;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueue_pos{0};
+    alignas(64) size_t dequeue_pos = 0;
+    atomic<size_t> consumed{0};
+    atomic<size_t> dropped{0};
+    atomic<LogLevel> min_level{static_cast<LogLevel>(LOG_MIN_LEVEL)};
+    ostream* sink = &cerr;
+    bool stopping = false;
+    mutex drain_lock;
+    condition_variable wake;
+    condition_variable drained;
+    thread worker;
+
+    static void put(Record& r, ArgType type, const void* data, size_t size) {
+        if (r.argc == MAX_ARGS || r.used + size > PAYLOAD) return;
+        r.types[r.argc++] = type;
+        memcpy(r.payload + r.used, data, size);
+        r.used += size;
+    }
+
+    static void putText(Record& r, string_view text) {
+        if (r.argc == MAX_ARGS || r.used == PAYLOAD) return;
+        uint8_t length = (uint8_t)min(text.size(), (size_t)(PAYLOAD - r.used - 1));
+        r.types[r.argc++] = ArgText;
+        r.payload[r.used++] = (char)length;
+        memcpy(r.payload + r.used, text.data(), length);
+        r.used += length;
+    }
+
+    template <typename T>
+    static void encode(Record& r, const T& value) {
+        if constexpr (is_floating_point_v<T>) {
+            double v = value;
+            put(r, ArgDouble, &v, sizeof(v));
+        } else if constexpr (is_integral_v<T> && is_signed_v<T>) {
+            int64_t v = value;
+            put(r, ArgInt, &v, sizeof(v));
+        } else if constexpr (is_integral_v<T> || is_enum_v<T>) {
+            uint64_t v = (uint64_t)value;
+            put(r, ArgUnsigned, &v, sizeof(v));
+        } else {
+            putText(r, string_view(value));
+        }
+    }
+
+    static const char* levelName(LogLevel level) {
+        static const char* names[] = {"DEBUG", "INFO ", "WARN ", "ERROR", "OFF  "};
+        return names[(int)level];
+    }
+
+    static void format(const Record& r, string& out) {
+        char buffer[64];
+        time_t seconds = r.time_us / 1000000;
+        tm local;
+        size_t n = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime_r(&seconds, &local));
+        n += snprintf(buffer + n, sizeof(buffer) - n, ".%03d ", (int)(r.time_us / 1000 % 1000));
+        out.append(buffer, n);
+        out += levelName(r.level);
+        out += ' ';
+        size_t offset = 0, arg = 0;
+        for (const char* p = r.format; *p; p++) {
+            if (p[0] != '{' || p[1] != '}' || arg == r.argc) {
+                out += *p;
+                continue;
+            }
+            p++;
+            if (r.types[arg] == ArgText) {
+                size_t length = (uint8_t)r.payload[offset];
+                out.append(r.payload + offset + 1, length);
+                offset += 1 + length;
+            } else {
+                char value[8];
+                memcpy(value, r.payload + offset, sizeof(value));
+                offset += sizeof(value);
+                int64_t i;
+                uint64_t u;
+                double d;
+                if (r.types[arg] == ArgInt) { memcpy(&i, value, 8); n = snprintf(buffer, sizeof(buffer), "%lld", (long long)i); }
+                else if (r.types[arg] == ArgUnsigned) { memcpy(&u, value, 8); n = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)u); }
+                else { memcpy(&d, value, 8); n = snprintf(buffer, sizeof(buffer), "%.2f", d); }
+                out.append(buffer, n);
+            }
+            arg++;
+        }
+        out += '\n';
+    }
+
+    void workerLoop() {
+        string text;
+        while (true) {
+            size_t batch = 0;
+            while (true) {
+                Record& r = ring[dequeue_pos & mask];
+                if (r.sequence.load(memory_order_acquire) != dequeue_pos + 1) break;
+                format(r, text);
+                r.sequence.store(dequeue_pos + mask + 1, memory_order_release);
+                dequeue_pos++;
+                batch++;
+            }
+            unique_lock<mutex> lock(drain_lock);
+            if (!text.empty() && sink != nullptr) {
+                sink->write(text.data(), text.size());
+                sink->flush();
+            }
+            text.clear();
+            if (batch > 0) {
+                consumed.store(dequeue_pos, memory_order_release);
+                drained.notify_all();
+                continue;
+            }
+            if (stopping) return;
+            // producers never notify, so an idle drain polls
+            wake.wait_for(lock, chrono::milliseconds(5));
+        }
+    }
+
+public:
+    Logger(size_t capacity = 8192) : ring(capacity), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; i++) ring[i].sequence.store(i, memory_order_relaxed);
+        worker = thread([this] { workerLoop(); });
+    }
+
+    ~Logger() {
+        {
+            lock_guard<mutex> lock(drain_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    bool enabled(LogLevel level) const { return level >= min_level.load(memory_order_relaxed); }
+
+    template <size_t N, typename... Args>
+    void log(LogLevel level, const char (&format)[N], const Args&... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        if (!enabled(level)) return;
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        Record* r;
+        while (true) {
+            r = &ring[pos & mask];
+            size_t sequence = r->sequence.load(memory_order_acquire);
+            if (sequence == pos) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            } else if (sequence < pos) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueue_pos.load(memory_order_relaxed);
+            }
+        }
+        r->time_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        r->format = format;
+        r->level = level;
+        r->argc = 0;
+        r->used = 0;
+        (encode(*r, args), ...);
+        r->sequence.store(pos + 1, memory_order_release);
+    }
+
+    // waits until everything logged before the call has reached the sink
+    void flush() {
+        size_t target = enqueue_pos.load(memory_order_acquire);
+        unique_lock<mutex> lock(drain_lock);
+        wake.notify_all();
+        drained.wait(lock, [&] { return consumed.load(memory_order_acquire) >= target; });
+    }
+
+    // nullptr discards; the previous sink is returned so it can be put back
+    ostream* setSink(ostream* _sink) {
+        flush();
+        lock_guard<mutex> lock(drain_lock);
+        swap(sink, _sink);
+        return _sink;
+    }
+
+    void setLevel(LogLevel level) { min_level.store(level, memory_order_relaxed); }
+    size_t getDroppedCount() const { return dropped.load(memory_order_relaxed); }
+};
+Logger logger;
+
+#define LOG_AT(level, ...) \
+    do { if constexpr ((int)(level) >= LOG_MIN_LEVEL) logger.log(level, __VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+// -------------------- Metrics --------------------
+// Call counts and latencies for the hot paths. A counter is one slot in a
+// per-thread block, so counting is a plain add on memory only that thread
+// writes; readers sum the blocks, and a thread's counts are folded into a
+// retired total when it exits. Latencies go into log-linear histograms (32
+// sub-buckets per power of two, about 3% error) sharded across threads.
+// A thread's first call of a metric and every SAMPLE_EVERY-th after it are
+// timed, so the clock reads stay off almost every call while short-lived
+// threads still show up. One registry per process: `metrics`.
+class Histogram {
+public:
+    static const int SUB_BITS = 5;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_EXPONENT = 40;   // ~18 minutes in nanoseconds
+    static const int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+    static const int SHARDS = 8;
+    static const uint64_t SAMPLE_EVERY = 1024;
+
+    static int bucketOf(uint64_t value) {
+        if (value < (uint64_t)SUB_COUNT) return (int)value;
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+        int sub = (int)(value >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+        return (exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+    }
+
+    // smallest value that lands in the bucket
+    static uint64_t bucketFloor(int bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        int exponent = bucket / SUB_COUNT + SUB_BITS - 1;
+        return (uint64_t)(SUB_COUNT + bucket % SUB_COUNT) << (exponent - SUB_BITS);
+    }
+
+    static uint64_t bucketMid(int bucket) {
+        uint64_t low = bucketFloor(bucket);
+        uint64_t width = bucket < SUB_COUNT ? 1 : bucketFloor(bucket + 1) - low;
+        return low + width / 2;
+    }
+
+    void record(uint64_t value_ns) {
+        Shard& shard = shards[shardIndex() % SHARDS];
+        shard.buckets[bucketOf(value_ns)].fetch_add(1, memory_order_relaxed);
+        shard.sum.fetch_add(value_ns, memory_order_relaxed);
+    }
+
+    // merged bucket counts, plus the number and total of the recorded values
+    vector<uint64_t> merge(uint64_t& count, uint64_t& sum) const {
+        vector<uint64_t> merged(BUCKETS, 0);
+        count = sum = 0;
+        for (int s = 0; s < SHARDS; s++) {
+            for (int b = 0; b < BUCKETS; b++) {
+                uint64_t n = shards[s].buckets[b].load(memory_order_relaxed);
+                merged[b] += n;
+                count += n;
+            }
+            sum += shards[s].sum.load(memory_order_relaxed);
+        }
+        return merged;
+    }
+
+    static uint64_t percentile(const vector<uint64_t>& merged, uint64_t count, double q) {
+        if (count == 0) return 0;
+        uint64_t rank = max<uint64_t>(1, (uint64_t)ceil(q * count)), seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += merged[b];
+            if (seen >= rank) return bucketMid(b);
+        }
+        return bucketMid(BUCKETS - 1);
+    }
+
+    static unsigned shardIndex() {
+        static atomic<unsigned> next_shard{0};
+        thread_local unsigned shard = next_shard++;
+        return shard;
+    }
+
+private:
+    struct alignas(64) Shard {
+        atomic<uint64_t> buckets[BUCKETS] = {};
+        atomic<uint64_t> sum{0};
+    };
+    unique_ptr<Shard[]> shards{new Shard[SHARDS]};
+};
+
+class Counter {
+private:
+    uint32_t id;
+public:
+    explicit Counter(uint32_t _id = 0) : id(_id) {}
+    // this thread's running count for the counter
+    inline uint64_t add(uint64_t n = 1) const;
+    uint32_t getId() const { return id; }
+};
+
+struct CallMetric {
+    Counter calls;
+    Histogram& latency;
+};
+
+struct HistogramSample {
+    string name;
+    string help;
+    uint64_t count;       // timed calls
+    double mean_ns;
+    uint64_t p50_ns, p90_ns, p99_ns, max_ns;
+};
+
+struct MetricsSnapshot {
+    vector<tuple<string, string, uint64_t>> counters;   // (name, help, value)
+    vector<HistogramSample> histograms;
+
+    uint64_t counter(const string& name) const {
+        for (auto& c : counters) {
+            if (get<0>(c) == name) return get<2>(c);
+        }
+        return 0;
+    }
+};
+
+class MetricsRegistry {
+public:
+    static const size_t MAX_COUNTERS = 128;
+
+private:
+    // written only by the owning thread, read by snapshots; aligned so no other data shares its lines
+    struct alignas(64) ThreadCounters {
+        atomic<uint64_t> values[MAX_COUNTERS] = {};
+    };
+
+    struct ThreadSlot {
+        ThreadCounters* counters = nullptr;
+        ~ThreadSlot();
+    };
+
+    mutable mutex registry_lock;
+    vector<pair<string, string>> counter_names;      // indexed by counter id
+    vector<ThreadCounters*> live;
+    uint64_t retired[MAX_COUNTERS] = {};
+    map<string, uint32_t> counter_ids;
+    map<string, pair<string, unique_ptr<Histogram>>> histograms;
+    inline static atomic<bool> enabled{true};
+
+    ThreadCounters* registerThread() {
+        ThreadCounters* counters = new ThreadCounters();
+        lock_guard<mutex> lock(registry_lock);
+        live.push_back(counters);
+        return counters;
+    }
+
+    void retireThread(ThreadCounters* counters) {
+        lock_guard<mutex> lock(registry_lock);
+        for (size_t i = 0; i < MAX_COUNTERS; i++) retired[i] += counters->values[i].load(memory_order_relaxed);
+        live.erase(find(live.begin(), live.end(), counters));
+        delete counters;
+    }
+
+    static void writeSeconds(ostream& out, uint64_t ns) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.9g", ns / 1e9);
+        out << buffer;
+    }
+
+public:
+    ~MetricsRegistry() {
+        for (ThreadCounters* counters : live) delete counters;
+    }
+
+    static inline atomic<uint64_t>* localCounters();
+
+    // while off, measured scopes neither count nor time their calls
+    static void setEnabled(bool on) { enabled.store(on, memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(memory_order_relaxed); }
+
+    // the same name returns the same counter
+    Counter counter(const string& name, const string& help) {
+        lock_guard<mutex> lock(registry_lock);
+        auto it = counter_ids.find(name);
+        if (it != counter_ids.end()) return Counter(it->second);
+        if (counter_names.size() == MAX_COUNTERS) throw runtime_error("metrics: too many counters");
+        uint32_t id = (uint32_t)counter_names.size();
+        counter_names.push_back({name, help});
+        counter_ids[name] = id;
+        return Counter(id);
+    }
+
+    Histogram& histogram(const string& name, const string& help) {
+        lock_guard<mutex> lock(registry_lock);
+        auto& entry = histograms[name];
+        if (entry.second == nullptr) entry = {help, make_unique<Histogram>()};
+        return *entry.second;
+    }
+
+    // <name>_total counts every call, <name>_seconds times a sample of them; callers
+    // keep the copy in a function static, beside its guard, so a scope touches no heap
+    CallMetric callMetric(const string& name, const string& help) {
+        Counter calls = counter(name + "_total", help);
+        return CallMetric{calls, histogram(name + "_seconds", help + " (latency)")};
+    }
+
+    MetricsSnapshot snapshot() const {
+        MetricsSnapshot result;
+        lock_guard<mutex> lock(registry_lock);
+        for (uint32_t id = 0; id < counter_names.size(); id++) {
+            uint64_t value = retired[id];
+            for (ThreadCounters* counters : live) value += counters->values[id].load(memory_order_relaxed);
+            result.counters.emplace_back(counter_names[id].first, counter_names[id].second, value);
+        }
+        for (auto& h : histograms) {
+            uint64_t count, sum;
+            vector<uint64_t> merged = h.second.second->merge(count, sum);
+            uint64_t max_ns = 0;
+            for (int b = Histogram::BUCKETS - 1; b >= 0 && max_ns == 0; b--) {
+                if (merged[b] > 0) max_ns = Histogram::bucketMid(b);
+            }
+            result.histograms.push_back({h.first, h.second.first, count, count ? (double)sum / count : 0.0,
+                                         Histogram::percentile(merged, count, 0.50), Histogram::percentile(merged, count, 0.90),
+                                         Histogram::percentile(merged, count, 0.99), max_ns});
+        }
+        return result;
+    }
+
+    // formatted locally, so the caller's stream keeps its own flags
+    void writeText(ostream& out) const {
+        MetricsSnapshot snap = snapshot();
+        ostringstream text;
+        text << "=== Metrics ===\n";
+        for (auto& c : snap.counters) text << get<0>(c) << ": " << get<2>(c) << "\n";
+        for (auto& h : snap.histograms) {
+            if (h.count == 0) continue;
+            text << h.name << ": " << h.count << " timed, mean " << fixed << setprecision(0) << h.mean_ns
+                 << "ns, p50 " << h.p50_ns << "ns, p90 " << h.p90_ns << "ns, p99 " << h.p99_ns << "ns, max " << h.max_ns << "ns\n";
+        }
+        text << "===============\n";
+        out << text.str() << flush;
+    }
+
+    // Prometheus text exposition; histograms are exported as summaries
+    void writePrometheus(ostream& out) const {
+        MetricsSnapshot snap = snapshot();
+        for (auto& c : snap.counters) {
+            out << "# HELP " << get<0>(c) << " " << get<1>(c) << "\n# TYPE " << get<0>(c) << " counter\n"
+                << get<0>(c) << " " << get<2>(c) << "\n";
+        }
+        for (auto& h : snap.histograms) {
+            out << "# HELP " << h.name << " " << h.help << "\n# TYPE " << h.name << " summary\n";
+            pair<const char*, uint64_t> quantiles[] = {{"0.5", h.p50_ns}, {"0.9", h.p90_ns}, {"0.99", h.p99_ns}};
+            for (auto& q : quantiles) {
+                out << h.name << "{quantile=\"" << q.first << "\"} ";
+                writeSeconds(out, q.second);
+                out << "\n";
+            }
+            out << h.name << "_sum ";
+            writeSeconds(out, (uint64_t)(h.mean_ns * h.count));
+            out << "\n" << h.name << "_count " << h.count << "\n";
+        }
+    }
+
+    // written beside the target and renamed over it, so a scraper never sees half a file
+    bool exportPrometheus(const string& path) const {
+        string temp = path + ".tmp";
+        {
+            ofstream out(temp);
+            if (!out) return false;
+            writePrometheus(out);
+            if (!out) return false;
+        }
+        return rename(temp.c_str(), path.c_str()) == 0;
+    }
+};
+MetricsRegistry metrics;
+
+MetricsRegistry::ThreadSlot::~ThreadSlot() {
+    if (counters != nullptr) metrics.retireThread(counters);
+}
+
+// the plain pointer keeps the hot path off the TLS wrapper that a
+// thread_local with a destructor needs; the slot only retires the block
+inline atomic<uint64_t>* MetricsRegistry::localCounters() {
+    thread_local ThreadCounters* counters = nullptr;
+    if (counters == nullptr) {
+        thread_local ThreadSlot slot;
+        slot.counters = counters = metrics.registerThread();
+    }
+    return counters->values;
+}
+
+inline uint64_t Counter::add(uint64_t n) const {
+    atomic<uint64_t>& slot = MetricsRegistry::localCounters()[id];
+    uint64_t value = slot.load(memory_order_relaxed) + n;
+    slot.store(value, memory_order_relaxed);
+    return value;
+}
+
+// counts the call and, for a sample of calls, times it
+class MetricScope {
+private:
+    const CallMetric& metric;
+    chrono::steady_clock::time_point start;
+    bool timed;
+public:
+    explicit MetricScope(const CallMetric& _metric)
+        : metric(_metric), timed(MetricsRegistry::isEnabled() && metric.calls.add() % Histogram::SAMPLE_EVERY == 1) {
+        if (timed) start = chrono::steady_clock::now();
+    }
+    ~MetricScope() {
+        if (timed) metric.latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+};
+
 // -------------------- Notification system --------------------
 enum class NotificationType { ORDER_CONFIRMED, ORDER_PREPARING, ORDER_READY, PROMOTION, NEW_COMBO };
 class Notification {
@@ -17,13 +578,13 @@ class Notification {
     string message;
     string timestamp;
     bool is_read;
-    inline static int notification_cnt = 0;
+    inline static atomic<int> notification_cnt{0};
     public:
     Notification(NotificationType _type, string _title, string _message)
         : type(_type), title(_title), message(_message), is_read(false) {
-            notification_cnt++;
+            int number = ++notification_cnt;
             stringstream ss;
-            ss << "N" << setw(3) << setfill('0') << notification_cnt;
+            ss << "N" << setw(3) << setfill('0') << number;
             notification_id = ss.str();
 
             auto now = chrono::system_clock::now();
@@ -32,11 +593,11 @@ class Notification {
             ts << put_time(localtime(&time_t), "%Y-%m-%d %H:%M:%S");
             timestamp = ts.str();
         }
-        void display() const{
-            cout<< "[" << timestamp << "] " << title <<endl;
-            cout<< " " << message <<endl;
-            cout << " ID: " << notification_id << " | Status: " << (is_read ? "Read" : "Unread") << endl;
-            cout << "------------------------" << endl;
+        void display(ostream& out = cout) const{
+            out<< "[" << timestamp << "] " << title <<endl;
+            out<< " " << message <<endl;
+            out << " ID: " << notification_id << " | Status: " << (is_read ? "Read" : "Unread") << endl;
+            out << "------------------------" << endl;
         }
         void markAsRead() { is_read = true; }
         string getId() const { return notification_id;}
@@ -80,18 +641,24 @@ class NotificationManager {
         }
     }
 
-    void enablePushNotifications() { 
+    void enablePushNotifications(ostream& out = cout) { 
         if (!permission_requested) {
-            cout << "Please request permission first." << endl;
+            out << "Please request permission first." << endl;
             return;
         }
         push_enabled = true; 
-        cout << "Push notifications enabled." << endl;
+        out << "Push notifications enabled." << endl;
     }
     
-    void disablePushNotifications() { 
+    void disablePushNotifications(ostream& out = cout) { 
         push_enabled = false; 
-        cout << "Push notifications disabled." << endl;
+        out << "Push notifications disabled." << endl;
+    }
+
+    // for kiosks configured at startup, where there is nobody to ask
+    void setPermission(bool granted) {
+        permission_requested = true;
+        push_enabled = granted;
     }
 
     bool isPermissionGranted() const {
@@ -103,13 +670,12 @@ class NotificationManager {
     }
 
     void sendNotification(NotificationType type, string title, string message) {
+        static const CallMetric sends = metrics.callMetric("notification_send", "Notification sends, including those with push disabled");
+        MetricScope measured(sends);
         if (!push_enabled) return;
         
-        Notification notification(type, title, message);
-        notifications.push_back(notification);
-        
-        cout << "\n[NEW NOTIFICATION]" << endl;
-        notification.display();
+        notifications.emplace_back(type, title, message); // built in place, no copy
+        LOG_INFO("notification {} sent: {} {}", notifications.back().getId(), title, message);
     }
 
     void sendOrderUpdate(string order_id, string status) {
@@ -145,29 +711,29 @@ class NotificationManager {
         sendNotification(NotificationType::NEW_COMBO, "New Combo Added!", message);
     }
 
-    void showAllNotifications() {
+    void showAllNotifications(ostream& out = cout) {
         if (notifications.empty()) {
-            cout << "No notifications available." << endl;
+            out << "No notifications available." << endl;
             return;
         }
         
-        cout << "\n == ALL NOTIFICATIONS == " << endl;
+        out << "\n == ALL NOTIFICATIONS == " << endl;
         for (auto& notification : notifications) {
-            notification.display();
+            notification.display(out);
         }
     }
 
-    void showUnreadNotifications() {
+    void showUnreadNotifications(ostream& out = cout) {
         bool hasUnread = false;
-        cout << "\n == UNREAD NOTIFICATIONS == " << endl;
+        out << "\n == UNREAD NOTIFICATIONS == " << endl;
         for (auto& notification : notifications) {
             if (!notification.isRead()) {
-                notification.display();
+                notification.display(out);
                 hasUnread = true;
             }
         }
         if (!hasUnread) {
-            cout << "No unread notifications." << endl;
+            out << "No unread notifications." << endl;
         }
     }
 
@@ -181,29 +747,328 @@ class NotificationManager {
 };
 
 NotificationManager notificationManager;
+
+// -------------------- Object Slabs --------------------
+// Catalog objects (foods, combos, orders, payments, reservations) are allocated
+// from per-type slabs. Each slot carries a generation number; destroying an
+// object bumps it, so a SlabRef taken earlier can tell in O(1) that its
+// object is gone instead of following a dangling pointer.
+struct SlabHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+class SlabBase {
+public:
+    virtual bool isLive(SlabHandle h) const = 0;
+    virtual ~SlabBase() {}
+};
+
+class SlabObject {
+private:
+    SlabBase* slab_owner = nullptr;
+    SlabHandle slab_handle;
+    template <typename Base, size_t SlotSize> friend class Slab;
+
+public:
+    SlabObject() {}
+    SlabObject(const SlabObject&) {}                          // copies are not slab-owned
+    SlabObject& operator=(const SlabObject&) { return *this; }
+
+    SlabBase* getSlabOwner() const { return slab_owner; }
+    SlabHandle getSlabHandle() const { return slab_handle; }
+    bool isSlabManaged() const { return slab_owner != nullptr; }
+};
+
+// Pointer plus generational handle. Objects created with plain new are not
+// tracked and behave like a raw pointer.
+// The check in get() does not keep the object alive: it only detects an object
+// that was destroyed before the call. It is meant for the thread that owns the
+// object (or code that holds the owner's lock). A reference shared with threads
+// that may destroy the object concurrently has to pin it instead, as FoodRef
+// does for menu foods.
+template <typename T>
+class SlabRef {
+private:
+    T* ptr = nullptr;
+    SlabBase* owner = nullptr;
+    SlabHandle handle;
+
+public:
+    SlabRef() {}
+    SlabRef(T* p) : ptr(p) {
+        if (p != nullptr) {
+            owner = p->getSlabOwner();
+            handle = p->getSlabHandle();
+        }
+    }
+
+    // valid until the owner destroys the object; see above
+    T* get() const {
+        if (owner != nullptr && !owner->isLive(handle)) return nullptr;
+        return ptr;
+    }
+    bool isDangling() const { return ptr != nullptr && get() == nullptr; }
+};
+
+struct SlabStats {
+    size_t live = 0;       // constructed objects
+    size_t free = 0;       // slots ready for reuse (shared list + thread caches)
+    size_t capacity = 0;   // slots ever carved from chunks
+};
+
+// Every slab type has a thread-local cache of free slot indexes, so steady
+// create/destroy churn never takes the slab lock or touches the heap; the
+// shared free list is only visited in batches. All subclasses of a slab's base
+// share one slot size (its size class).
+template <typename Base, size_t SlotSize = sizeof(Base)>
+class Slab : public SlabBase {
+private:
+    static const uint32_t CHUNK_SLOTS = 256;
+    static const uint32_t MAX_CHUNKS = 16384;
+    static const size_t CACHE_BATCH = 64;
+
+    // odd generation = live; bumped on make and on destroy
+    struct Slot {
+        alignas(alignof(max_align_t)) unsigned char storage[SlotSize];
+        Base* object = nullptr;            // null while the slot is free
+        atomic<uint32_t> generation{0};
+    };
+
+    // Thread caches reach their slab through an anchor they share, so a cache
+    // that outlives its slab sees that the slab is gone instead of writing
+    // into freed memory.
+    struct Anchor {
+        mutex lock;
+        atomic<Slab*> slab;
+        Anchor(Slab* s) : slab(s) {}
+    };
+
+    struct LocalCache {
+        shared_ptr<Anchor> anchor;
+        vector<uint32_t> slots;
+        ~LocalCache() {
+            if (anchor == nullptr) return;
+            lock_guard<mutex> lock(anchor->lock);
+            if (Slab* owner = anchor->slab.load()) owner->giveBack(slots, slots.size());
+        }
+    };
+
+    // fixed directory so lookups never race with growth
+    unique_ptr<atomic<Slot*>[]> chunks;
+    shared_ptr<Anchor> anchor;
+    uint32_t slot_count = 0;
+    vector<uint32_t> free_slots;
+    atomic<size_t> live_count{0};
+    mutable mutex slab_lock;
+
+    Slot* slotAt(uint32_t index) const {
+        if (index / CHUNK_SLOTS >= MAX_CHUNKS) return nullptr;
+        Slot* chunk = chunks[index / CHUNK_SLOTS].load(memory_order_acquire);
+        return chunk ? &chunk[index % CHUNK_SLOTS] : nullptr;
+    }
+
+    // one cache per thread per slab type; a second live slab of the same type
+    // simply bypasses it, and the cache of a destroyed slab is taken over
+    LocalCache* localCache() {
+        static thread_local LocalCache cache;
+        if (cache.anchor == anchor) return &cache;
+        if (cache.anchor == nullptr || cache.anchor->slab.load() == nullptr) {
+            cache.anchor = anchor;
+            cache.slots.clear();
+            cache.slots.reserve(2 * CACHE_BATCH);
+            return &cache;
+        }
+        return nullptr;
+    }
+
+    void refill(vector<uint32_t>& out, size_t count) {
+        lock_guard<mutex> lock(slab_lock);
+        while (count > 0 && !free_slots.empty()) {
+            out.push_back(free_slots.back());
+            free_slots.pop_back();
+            count--;
+        }
+        while (count > 0) {
+            if (slot_count % CHUNK_SLOTS == 0) {
+                if (slot_count / CHUNK_SLOTS >= MAX_CHUNKS) {
+                    if (out.empty()) throw runtime_error("slab is full");
+                    break;
+                }
+                chunks[slot_count / CHUNK_SLOTS].store(new Slot[CHUNK_SLOTS], memory_order_release);
+            }
+            out.push_back(slot_count++);
+            count--;
+        }
+    }
+
+    void giveBack(vector<uint32_t>& from, size_t count) {
+        lock_guard<mutex> lock(slab_lock);
+        for (size_t i = 0; i < count; i++) {
+            free_slots.push_back(from.back());
+            from.pop_back();
+        }
+    }
+
+    uint32_t takeSlot() {
+        LocalCache* cache = localCache();
+        if (cache == nullptr) {
+            vector<uint32_t> one;
+            refill(one, 1);
+            return one.back();
+        }
+        if (cache->slots.empty()) refill(cache->slots, CACHE_BATCH);
+        uint32_t index = cache->slots.back();
+        cache->slots.pop_back();
+        return index;
+    }
+
+    void releaseSlot(uint32_t index) {
+        LocalCache* cache = localCache();
+        if (cache == nullptr) {
+            lock_guard<mutex> lock(slab_lock);
+            free_slots.push_back(index);
+            return;
+        }
+        cache->slots.push_back(index);
+        if (cache->slots.size() >= 2 * CACHE_BATCH) giveBack(cache->slots, CACHE_BATCH);
+    }
+
+public:
+    Slab() : chunks(new atomic<Slot*>[MAX_CHUNKS]), anchor(make_shared<Anchor>(this)) {
+        for (uint32_t i = 0; i < MAX_CHUNKS; i++) chunks[i].store(nullptr);
+    }
+
+    ~Slab() {
+        {
+            lock_guard<mutex> lock(anchor->lock);
+            anchor->slab.store(nullptr);
+        }
+        for (uint32_t i = 0; i < slot_count; i++) {
+            Slot* slot = slotAt(i);
+            if (slot->object != nullptr) slot->object->~Base();
+        }
+        for (uint32_t c = 0; c * CHUNK_SLOTS < slot_count; c++) delete[] chunks[c].load();
+    }
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    template <typename U = Base, typename... Args>
+    U* make(Args&&... args) {
+        static_assert(is_base_of<Base, U>::value, "slab type mismatch");
+        static_assert(sizeof(U) <= SlotSize, "object does not fit the slab slot");
+        uint32_t index = takeSlot();
+        Slot* slot = slotAt(index);
+        U* obj;
+        try {
+            obj = new (slot->storage) U(std::forward<Args>(args)...);
+        } catch (...) {
+            releaseSlot(index);
+            throw;
+        }
+        slot->object = obj;
+        obj->slab_owner = this;
+        obj->slab_handle = SlabHandle{index, slot->generation.load(memory_order_relaxed) + 1};
+        slot->generation.fetch_add(1, memory_order_release);
+        live_count.fetch_add(1, memory_order_relaxed);
+        return obj;
+    }
+
+    bool isLive(SlabHandle h) const override {
+        Slot* slot = slotAt(h.index);
+        return slot != nullptr && h.generation % 2 == 1 && slot->generation.load(memory_order_acquire) == h.generation;
+    }
+
+    Base* get(SlabHandle h) const {
+        return isLive(h) ? slotAt(h.index)->object : nullptr;
+    }
+
+    bool destroy(SlabHandle h) {
+        Slot* slot = slotAt(h.index);
+        if (slot == nullptr || h.generation % 2 == 0) return false;   // free slots have even generations
+        // bumping the generation invalidates every handle; only one caller wins
+        uint32_t expected = h.generation;
+        if (!slot->generation.compare_exchange_strong(expected, h.generation + 1)) return false;
+        slot->object->~Base();
+        slot->object = nullptr;
+        live_count.fetch_sub(1, memory_order_relaxed);
+        releaseSlot(h.index);
+        return true;
+    }
+
+    bool destroy(Base* obj) {
+        return obj != nullptr && obj->getSlabOwner() == this && destroy(obj->getSlabHandle());
+    }
+
+    size_t getLiveCount() const { return live_count.load(); }
+
+    SlabStats getStats() const {
+        lock_guard<mutex> lock(slab_lock);
+        SlabStats stats;
+        stats.live = live_count.load();
+        stats.capacity = slot_count;
+        stats.free = stats.capacity - stats.live;   // every carved slot is live or free
+        return stats;
+    }
+};
+
 // ================= Food =================
-class Food {
+struct Recipe;
+
+class Food : public SlabObject {
 protected:
     string id;
     string name;
     double price;
+    atomic<const Recipe*> recipe{nullptr};   // filled in by the inventory on first use
+    friend class Inventory;
+
+private:
+    atomic<int> pins{0};             // one for the menu plus one per FoodRef
+    atomic<bool> on_menu{false};
 
 public:
-    inline static int cnt = 0;
+    inline static atomic<int> cnt{0};
     Food(string _name, double _price) : name(_name), price(_price) {
-        cnt++;
+        int number = ++cnt;
         stringstream ss;
-        ss << "F" << setw(3) << setfill('0') << cnt;
+        ss << "F" << setw(3) << setfill('0') << number;
         id = ss.str();
     }
 
-    virtual void display() {
-        cout << "ID: " << id << ", Name: " << name << ", Price: $" << price << endl;
+    virtual void display(ostream& out = cout) {
+        out << "ID: " << id << ", Name: " << name << ", Price: $" << price << endl;
     }
 
     string getId() { return id; }
     string getName() { return name; }
     double getPrice() { return price; }
+    void setId(string _id) { id = _id; }
+
+    // The menu holds one pin while the food is listed. Once it is removed the
+    // food is freed by whoever drops the last pin.
+    void adoptByMenu() {
+        if (!on_menu.exchange(true)) pins.fetch_add(1);
+    }
+    // the menu's pin moves to its retired list; foods it never adopted get one
+    void leaveMenu() {
+        if (!on_menu.exchange(false)) pins.fetch_add(1);
+    }
+    bool isOnMenu() { return on_menu.load(); }
+
+    // Only menu-owned foods can be pinned; the caller must already hold the
+    // food alive (inside a MenuReader or through another pin).
+    bool pin() {
+        int n = pins.load();
+        while (n > 0 && !pins.compare_exchange_weak(n, n + 1)) {}
+        return n > 0;
+    }
+    bool unpin() { return pins.fetch_sub(1) == 1; }   // true for the last pin
+
+    // type tag and subclass fields used by the menu import/export format
+    virtual string getType() { return "food"; }
+    virtual vector<string> getFields() { return {}; }
 
     virtual ~Food() {}
 };
@@ -217,11 +1082,14 @@ public:
     rice_don(string _name, double _price, string _rice_type = "White Rice", string _protein = "Chicken")
         : Food(_name, _price), rice_type(_rice_type), protein(_protein) {}
 
-    void display() override {
-        cout << "ID: " << id << ", Rice Don: " << name
+    void display(ostream& out = cout) override {
+        out << "ID: " << id << ", Rice Don: " << name
              << ", Rice: " << rice_type << ", Protein: " << protein
              << ", Price: $" << price << endl;
     }
+
+    string getType() override { return "rice_don"; }
+    vector<string> getFields() override { return {rice_type, protein}; }
 };
 
 class ramen : public Food {
@@ -233,11 +1101,14 @@ public:
     ramen(string _name, double _price, string _broth = "Tonkotsu", string _noodle = "Thin")
         : Food(_name, _price), broth_type(_broth), noodle_type(_noodle) {}
 
-    void display() override {
-        cout << "ID: " << id << ", Ramen: " << name
+    void display(ostream& out = cout) override {
+        out << "ID: " << id << ", Ramen: " << name
              << ", Broth: " << broth_type << ", Noodles: " << noodle_type
              << ", Price: $" << price << endl;
     }
+
+    string getType() override { return "ramen"; }
+    vector<string> getFields() override { return {broth_type, noodle_type}; }
 };
 
 class topping : public Food {
@@ -248,11 +1119,14 @@ public:
     topping(string _name, double _price, string _category = "Vegetable")
         : Food(_name, _price), category(_category) {}
 
-    void display() override {
-        cout << "ID: " << id << ", Topping: " << name
+    void display(ostream& out = cout) override {
+        out << "ID: " << id << ", Topping: " << name
              << ", Category: " << category
              << ", Price: $" << price << endl;
     }
+
+    string getType() override { return "topping"; }
+    vector<string> getFields() override { return {category}; }
 };
 
 class SideDish : public Food {
@@ -264,12 +1138,15 @@ public:
     SideDish(string _name, double _price, string _type = "Appetizer", bool _veg = false)
         : Food(_name, _price), dish_type(_type), is_vegetarian(_veg) {}
 
-    void display() override {
-        cout << "ID: " << id << ", Side Dish: " << name
+    void display(ostream& out = cout) override {
+        out << "ID: " << id << ", Side Dish: " << name
              << ", Type: " << dish_type
              << ", Vegetarian: " << (is_vegetarian ? "Yes" : "No")
              << ", Price: $" << price << endl;
     }
+
+    string getType() override { return "side_dish"; }
+    vector<string> getFields() override { return {dish_type, is_vegetarian ? "1" : "0"}; }
 };
 
 class Drink : public Food {
@@ -277,68 +1154,670 @@ private:
     string oz;
 public:
     Drink(string _name, double _price, string _oz) : Food(_name, _price), oz(_oz) {}
-    void display() override {
-        cout << "ID: " << id << ", Drink: " << name
+    void display(ostream& out = cout) override {
+        out << "ID: " << id << ", Drink: " << name
              << ", Ounces: " << oz
              << ", Price: $" << price << endl;
     }
-};
 
-// -------------------- Manage Food --------------------
-map<string, Food*> manageFood;
+    string getType() override { return "drink"; }
+    vector<string> getFields() override { return {oz}; }
+};
 
-void addToManageFood(Food* food) {
-    if (food != nullptr) {
-        manageFood[food->getId()] = food;
-    }
-}
+const size_t FOOD_SLOT = max({sizeof(Food), sizeof(rice_don), sizeof(ramen),
+                              sizeof(topping), sizeof(SideDish), sizeof(Drink)});
+Slab<Food, FOOD_SLOT> foodSlab;
 
-void displayAllFood() {
-    cout << "=== All Available Food Items ===" << endl;
-    for (auto& pair : manageFood) {
-        pair.second->display();
-    }
-    cout << "===============================" << endl;
+// frees a food the way it was allocated
+void freeFood(Food* food) {
+    if (food == nullptr) return;
+    if (food->isSlabManaged()) foodSlab.destroy(food);
+    else delete food;
 }
 
-Food* findFoodById(string id) {
-    auto it = manageFood.find(id);
-    return (it != manageFood.end()) ? it->second : nullptr;
+void unpinFood(Food* food) {
+    if (food->unpin()) freeFood(food);
 }
 
-// -------------------- Combo --------------------
-class Combo {
+// Reference held by orders, combos and menu lookups. A menu food stays alive
+// while referenced, even after it has been removed from the menu. Foods the
+// menu never owned are not pinned and are only checked through their slab
+// generation, so their owner can still free them.
+class FoodRef {
 private:
-    vector<Food*> FoodHavecombo;
-    string combo_id;
-    string combo_name;
-    double price;
-    double discount;
-    inline static int combo_cnt = 0;
+    SlabRef<Food> ref;
+    Food* pinned = nullptr;
 
 public:
-    Combo(string _combo_name, double _discount = 0.1)
-        : combo_name(_combo_name), discount(_discount) {
-        combo_cnt++;
-        stringstream ss;
-        ss << "C" << setw(3) << setfill('0') << combo_cnt;
-        combo_id = ss.str();
-        price = 0.0;
-        notificationManager.sendNewCombo(_combo_name, _discount); //new combo notification
+    FoodRef() {}
+    FoodRef(Food* food) : ref(food) {
+        if (food != nullptr && food->pin()) pinned = food;
     }
-
-    void addFood(Food* food) {
-        if (food != nullptr) {
-            FoodHavecombo.push_back(food);
-            calculatePrice();
-        }
+    FoodRef(const FoodRef& other) : ref(other.ref) {
+        if (other.pinned != nullptr && other.pinned->pin()) pinned = other.pinned;
+    }
+    FoodRef(FoodRef&& other) : ref(other.ref), pinned(other.pinned) { other.pinned = nullptr; }
+    FoodRef& operator=(FoodRef other) {
+        swap(ref, other.ref);
+        swap(pinned, other.pinned);
+        return *this;
+    }
+    ~FoodRef() {
+        if (pinned != nullptr) unpinFood(pinned);
     }
 
-    void removeFood(string food_id) {
-        for (auto it = FoodHavecombo.begin(); it != FoodHavecombo.end(); ++it) {
-            if ((*it)->getId() == food_id) {
-                FoodHavecombo.erase(it);
-                calculatePrice();
+    Food* get() const { return pinned != nullptr ? pinned : ref.get(); }
+    Food* operator->() const { return get(); }
+    explicit operator bool() const { return get() != nullptr; }
+    // true once the food has left the menu (or was freed by its owner)
+    bool isOffMenu() const { return pinned != nullptr ? !pinned->isOnMenu() : ref.isDangling(); }
+};
+
+// -------------------- Inventory --------------------
+// Stock is counted per ingredient. A food's recipe comes from its fields: a
+// ramen uses its broth and noodles, a rice don its rice and protein, and any
+// other food is its own single ingredient. Ingredients nobody has stocked are
+// not tracked and never run out. Recipes are built once and cached on the
+// food, so reserving stock for an order line is only CAS loops on the
+// ingredient counters, without locks.
+struct Ingredient {
+    string name;
+    atomic<long long> stock{0};
+    atomic<bool> tracked{false};
+};
+
+struct RecipeItem {
+    Ingredient* ingredient;
+    int quantity;
+};
+
+struct Recipe {
+    vector<RecipeItem> items;
+};
+
+// called when an ingredient may have run out or come back; defined with the menu availability index
+void onStockEdge(Ingredient* ingredient);
+
+class Inventory {
+private:
+    deque<Ingredient> ingredients;   // push_back never moves existing elements
+    unordered_map<string, Ingredient*> by_name;
+    vector<unique_ptr<Recipe>> recipes;   // kept for the inventory's lifetime; orders point into it
+    mutex registry_lock;
+
+    Ingredient* ingredientLocked(const string& name) {
+        auto it = by_name.find(name);
+        if (it != by_name.end()) return it->second;
+        ingredients.emplace_back();
+        Ingredient* ingredient = &ingredients.back();
+        ingredient->name = name;
+        by_name[name] = ingredient;
+        return ingredient;
+    }
+
+public:
+    const Recipe* recipeFor(Food* food) {
+        const Recipe* cached = food->recipe.load(memory_order_acquire);
+        if (cached != nullptr) return cached;
+
+        vector<string> fields = food->getFields();
+        vector<string> parts;
+        if (food->getType() == "ramen" && fields.size() == 2) parts = {fields[0] + " broth", fields[1] + " noodles"};
+        else if (food->getType() == "rice_don" && fields.size() == 2) parts = {fields[0], fields[1]};
+        else parts = {food->getName()};
+
+        lock_guard<mutex> lock(registry_lock);
+        cached = food->recipe.load(memory_order_acquire);
+        if (cached != nullptr) return cached;
+        unique_ptr<Recipe> recipe(new Recipe());
+        for (string& part : parts) recipe->items.push_back({ingredientLocked(part), 1});
+        recipes.push_back(move(recipe));
+        food->recipe.store(recipes.back().get(), memory_order_release);
+        return recipes.back().get();
+    }
+
+private:
+    static void startTracking(Ingredient* ingredient, long long quantity) {
+        ingredient->stock.store(quantity, memory_order_release);
+        ingredient->tracked.store(true, memory_order_release);
+    }
+
+    static bool take(Ingredient* ingredient, int quantity) {
+        if (!ingredient->tracked.load(memory_order_acquire)) return true;
+        long long stock = ingredient->stock.load(memory_order_relaxed);
+        do {
+            if (stock < quantity) return false;
+        } while (!ingredient->stock.compare_exchange_weak(stock, stock - quantity, memory_order_acq_rel));
+        if (stock == quantity) onStockEdge(ingredient);   // took the last of it
+        return true;
+    }
+
+    static void giveBack(Ingredient* ingredient, int quantity) {
+        if (!ingredient->tracked.load(memory_order_acquire)) return;
+        if (ingredient->stock.fetch_add(quantity, memory_order_acq_rel) <= 0) onStockEdge(ingredient);
+    }
+
+public:
+    static const long long LOW_STOCK = 5;
+
+    // reserves every ingredient of the food, or none; nullptr means out of stock
+    const Recipe* reserve(Food* food) {
+        const Recipe* recipe = recipeFor(food);
+        for (size_t i = 0; i < recipe->items.size(); i++) {
+            if (!take(recipe->items[i].ingredient, recipe->items[i].quantity)) {
+                while (i-- > 0) giveBack(recipe->items[i].ingredient, recipe->items[i].quantity);
+                return nullptr;
+            }
+        }
+        return recipe;
+    }
+
+    void release(const Recipe* recipe) {
+        if (recipe == nullptr) return;
+        for (const RecipeItem& item : recipe->items) giveBack(item.ingredient, item.quantity);
+    }
+
+    bool isAvailable(Food* food) {
+        for (const RecipeItem& item : recipeFor(food)->items) {
+            if (item.ingredient->tracked.load(memory_order_acquire)
+                && item.ingredient->stock.load(memory_order_acquire) < item.quantity) return false;
+        }
+        return true;
+    }
+
+    vector<string> getIngredients(Food* food) {
+        vector<string> names;
+        for (const RecipeItem& item : recipeFor(food)->items) names.push_back(item.ingredient->name);
+        return names;
+    }
+
+    // starts tracking the ingredient at exactly this much stock
+    void setStock(const string& name, long long quantity) {
+        Ingredient* ingredient;
+        {
+            lock_guard<mutex> lock(registry_lock);
+            ingredient = ingredientLocked(name);
+            startTracking(ingredient, quantity);
+        }
+        onStockEdge(ingredient);
+    }
+
+    void addStock(const string& name, long long quantity) {
+        Ingredient* ingredient;
+        {
+            lock_guard<mutex> lock(registry_lock);
+            ingredient = ingredientLocked(name);
+            if (!ingredient->tracked.load()) startTracking(ingredient, quantity);
+            else ingredient->stock.fetch_add(quantity, memory_order_acq_rel);
+        }
+        onStockEdge(ingredient);
+    }
+
+    // -1 for ingredients that are not tracked
+    long long getStock(const string& name) {
+        lock_guard<mutex> lock(registry_lock);
+        auto it = by_name.find(name);
+        if (it == by_name.end() || !it->second->tracked.load()) return -1;
+        return it->second->stock.load();
+    }
+
+    void displayStock(ostream& out = cout) {
+        lock_guard<mutex> lock(registry_lock);
+        out << "=== Ingredient Stock ===" << endl;
+        for (Ingredient& ingredient : ingredients) {
+            if (!ingredient.tracked.load()) continue;
+            long long stock = ingredient.stock.load();
+            out << ingredient.name << ": " << stock;
+            if (stock <= 0) out << " (SOLD OUT)";
+            else if (stock <= LOW_STOCK) out << " (low)";
+            out << endl;
+        }
+        out << "========================" << endl;
+    }
+};
+Inventory inventory;
+
+// -------------------- Menu Availability --------------------
+// Reverse index from ingredient to the foods that use it, and from food to
+// the combos that contain it. Each food counts its sold-out ingredients and
+// each combo its hidden foods; a bit is flipped only when a count crosses
+// zero, so a sold-out or restock event touches just the affected items. Menu
+// views test the bits instead of checking stock. Foods and combos are keyed
+// by id, so nothing here points at a food that may have been freed.
+class MenuAvailability {
+private:
+    struct IngredientNode {
+        bool sold_out = false;
+        vector<uint32_t> foods;
+    };
+    struct FoodNode {
+        string id;
+        vector<Ingredient*> ingredients;
+        vector<uint32_t> combos;
+        int blocked = 0;   // sold-out ingredients
+        bool live = false;
+    };
+    struct ComboNode {
+        vector<uint32_t> foods;
+        int blocked = 0;   // hidden foods
+        bool live = false;
+    };
+
+    unordered_map<Ingredient*, IngredientNode> ingredient_nodes;
+    unordered_map<string, uint32_t> food_slots;
+    unordered_map<string, uint32_t> combo_slots;
+    vector<FoodNode> foods;
+    vector<ComboNode> combos;
+    vector<uint32_t> free_food_slots;
+    vector<uint32_t> free_combo_slots;
+    vector<uint64_t> food_hidden;    // bitsets indexed by slot
+    vector<uint64_t> combo_hidden;
+    mutable mutex index_lock;
+    atomic<long> generation{0};      // bumped whenever visibility may have changed
+
+    static bool testBit(const vector<uint64_t>& bits, uint32_t i) { return (bits[i / 64] >> (i % 64)) & 1; }
+    static void setBit(vector<uint64_t>& bits, uint32_t i, bool on) {
+        if (on) bits[i / 64] |= 1ULL << (i % 64);
+        else bits[i / 64] &= ~(1ULL << (i % 64));
+    }
+
+    template <typename Node>
+    static uint32_t takeSlot(vector<Node>& nodes, vector<uint32_t>& free_slots, vector<uint64_t>& bits) {
+        if (!free_slots.empty()) {
+            uint32_t slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
+        if (nodes.size() % 64 == 0) bits.push_back(0);
+        nodes.emplace_back();
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    void setFoodBlocked(uint32_t slot, int delta) {
+        FoodNode& food = foods[slot];
+        bool was_hidden = food.blocked > 0;
+        food.blocked += delta;
+        bool hidden = food.blocked > 0;
+        if (hidden == was_hidden) return;
+        setBit(food_hidden, slot, hidden);
+        for (uint32_t c : food.combos) setComboBlocked(c, hidden ? 1 : -1);
+    }
+
+    void setComboBlocked(uint32_t slot, int delta) {
+        ComboNode& combo = combos[slot];
+        combo.blocked += delta;
+        setBit(combo_hidden, slot, combo.blocked > 0);
+    }
+
+    IngredientNode& nodeFor(Ingredient* ingredient) {
+        auto it = ingredient_nodes.find(ingredient);
+        if (it != ingredient_nodes.end()) return it->second;
+        IngredientNode& node = ingredient_nodes[ingredient];
+        node.sold_out = ingredient->tracked.load() && ingredient->stock.load() <= 0;
+        return node;
+    }
+
+    // the food's slot, registering it as an unlisted food if needed
+    uint32_t foodSlot(Food* food) {
+        auto it = food_slots.find(food->getId());
+        if (it != food_slots.end()) return it->second;
+        uint32_t slot = takeSlot(foods, free_food_slots, food_hidden);
+        food_slots[food->getId()] = slot;
+        FoodNode& node = foods[slot];
+        node.id = food->getId();
+        for (const RecipeItem& item : inventory.recipeFor(food)->items) {
+            IngredientNode& ingredient = nodeFor(item.ingredient);
+            ingredient.foods.push_back(slot);
+            node.ingredients.push_back(item.ingredient);
+            if (ingredient.sold_out) node.blocked++;
+        }
+        setBit(food_hidden, slot, node.blocked > 0);
+        return slot;
+    }
+
+    void dropFood(uint32_t slot) {
+        FoodNode& node = foods[slot];
+        for (Ingredient* ingredient : node.ingredients) {
+            vector<uint32_t>& users = ingredient_nodes[ingredient].foods;
+            users.erase(find(users.begin(), users.end(), slot));
+        }
+        food_slots.erase(node.id);
+        node = FoodNode();
+        setBit(food_hidden, slot, false);
+        free_food_slots.push_back(slot);
+    }
+
+public:
+    void addFood(Food* food) {
+        if (food == nullptr) return;
+        lock_guard<mutex> lock(index_lock);
+        foods[foodSlot(food)].live = true;
+        generation++;
+    }
+
+    void removeFood(const string& food_id) {
+        lock_guard<mutex> lock(index_lock);
+        auto it = food_slots.find(food_id);
+        if (it == food_slots.end()) return;
+        FoodNode& node = foods[it->second];
+        node.live = false;
+        if (node.combos.empty()) dropFood(it->second);   // combos still need it otherwise
+        generation++;
+    }
+
+    void addCombo(const string& combo_id, const vector<Food*>& combo_foods) {
+        lock_guard<mutex> lock(index_lock);
+        if (combo_slots.count(combo_id)) return;
+        uint32_t slot = takeSlot(combos, free_combo_slots, combo_hidden);
+        combo_slots[combo_id] = slot;
+        ComboNode node;
+        node.live = true;
+        for (Food* food : combo_foods) {
+            if (food == nullptr) continue;
+            uint32_t f = foodSlot(food);
+            foods[f].combos.push_back(slot);
+            node.foods.push_back(f);
+            if (foods[f].blocked > 0) node.blocked++;
+        }
+        combos[slot] = node;
+        setBit(combo_hidden, slot, node.blocked > 0);
+        generation++;
+    }
+
+    void removeCombo(const string& combo_id) {
+        lock_guard<mutex> lock(index_lock);
+        auto it = combo_slots.find(combo_id);
+        if (it == combo_slots.end()) return;
+        uint32_t slot = it->second;
+        for (uint32_t f : combos[slot].foods) {
+            vector<uint32_t>& owners = foods[f].combos;
+            owners.erase(find(owners.begin(), owners.end(), slot));
+            if (!foods[f].live && owners.empty()) dropFood(f);
+        }
+        combos[slot] = ComboNode();
+        setBit(combo_hidden, slot, false);
+        free_combo_slots.push_back(slot);
+        combo_slots.erase(it);
+        generation++;
+    }
+
+    // re-reads the ingredient's stock and propagates a change to its foods and combos
+    void refresh(Ingredient* ingredient) {
+        lock_guard<mutex> lock(index_lock);
+        auto it = ingredient_nodes.find(ingredient);
+        if (it == ingredient_nodes.end()) return;
+        bool sold_out = ingredient->tracked.load() && ingredient->stock.load() <= 0;
+        if (sold_out == it->second.sold_out) return;
+        it->second.sold_out = sold_out;
+        for (uint32_t f : it->second.foods) setFoodBlocked(f, sold_out ? 1 : -1);
+        generation++;
+    }
+
+    // foods and combos the index has never seen are visible
+    bool isFoodVisible(const string& food_id) const {
+        lock_guard<mutex> lock(index_lock);
+        auto it = food_slots.find(food_id);
+        return it == food_slots.end() || !testBit(food_hidden, it->second);
+    }
+
+    bool isComboVisible(const string& combo_id) const {
+        lock_guard<mutex> lock(index_lock);
+        auto it = combo_slots.find(combo_id);
+        return it == combo_slots.end() || !testBit(combo_hidden, it->second);
+    }
+
+    long getGeneration() const { return generation.load(); }
+};
+MenuAvailability menuAvailability;
+
+void onStockEdge(Ingredient* ingredient) {
+    menuAvailability.refresh(ingredient);
+}
+
+// -------------------- Manage Food --------------------
+// The menu is published as immutable versions. Readers pin the current version
+// through a MenuReader (no lock, only an epoch announcement); staff edits copy
+// the current version, change the copy and swap it in atomically. Old versions,
+// and the foods removed with them, are freed once every reader that could still
+// see them has finished (epoch-based reclamation). A removed food that an order
+// or combo still references through a FoodRef lives until the last one drops.
+class Combo;
+
+struct MenuVersion {
+    long version = 0;
+    map<string, Food*, less<>> foods;     // transparent, so ids can be looked up as string_view
+    map<string, Combo*, less<>> combos;
+};
+
+class MenuStore {
+private:
+    static const int MAX_READERS = 256;
+
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch{0};      // 0 = not reading
+        atomic<bool> taken{false};
+    };
+
+    struct Retired {
+        MenuVersion* version;
+        vector<Food*> foods;
+        uint64_t epoch;
+    };
+
+    // one reader slot per thread, released when the thread exits
+    struct SlotClaim {
+        MenuStore* store = nullptr;
+        int index = -1;
+        int depth = 0;
+        ~SlotClaim() {
+            if (store != nullptr) store->slots[index].taken.store(false);
+        }
+    };
+
+    atomic<MenuVersion*> current;
+    atomic<uint64_t> global_epoch{1};
+    ReaderSlot slots[MAX_READERS];
+    mutex write_lock;
+    vector<Retired> retired;
+    long reclaimed = 0;
+
+    SlotClaim& claim() {
+        static thread_local SlotClaim mine;
+        if (mine.store == nullptr) {
+            for (int i = 0; i < MAX_READERS; i++) {
+                bool expected = false;
+                if (slots[i].taken.compare_exchange_strong(expected, true)) {
+                    mine.store = this;
+                    mine.index = i;
+                    return mine;
+                }
+            }
+            throw runtime_error("too many menu reader threads");
+        }
+        return mine;
+    }
+
+    void reclaim() {
+        uint64_t oldest = UINT64_MAX;
+        for (ReaderSlot& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+        size_t kept = 0;
+        for (Retired& r : retired) {
+            if (r.epoch < oldest) {
+                for (Food* food : r.foods) unpinFood(food);
+                delete r.version;
+                reclaimed++;
+            } else {
+                retired[kept++] = r;
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    class MenuReader {
+    private:
+        MenuStore* store;
+        MenuVersion* version;
+    public:
+        MenuReader(MenuStore* _store) : store(_store) {
+            SlotClaim& c = store->claim();
+            if (c.depth++ == 0) {
+                store->slots[c.index].epoch.store(store->global_epoch.load());
+            }
+            version = store->current.load();
+        }
+        ~MenuReader() {
+            SlotClaim& c = store->claim();
+            if (--c.depth == 0) store->slots[c.index].epoch.store(0);
+        }
+        MenuReader(const MenuReader&) = delete;
+        MenuReader& operator=(const MenuReader&) = delete;
+
+        const MenuVersion* operator->() const { return version; }
+        const MenuVersion& operator*() const { return *version; }
+    };
+
+    MenuStore() : current(new MenuVersion()) {}
+
+    ~MenuStore() {
+        for (Retired& r : retired) {
+            for (Food* food : r.foods) unpinFood(food);
+            delete r.version;
+        }
+        delete current.load();
+    }
+
+    MenuReader read() { return MenuReader(this); }
+
+    // Builds the next version from a copy of the current one. Foods the edit
+    // pushes into `removed` drop the menu's pin together with the old version,
+    // and are freed then unless an order or combo still holds them.
+    void update(function<void(MenuVersion&, vector<Food*>&)> edit) {
+        lock_guard<mutex> lock(write_lock);
+        MenuVersion* old = current.load();
+        MenuVersion* next = new MenuVersion(*old);
+        vector<Food*> removed;
+        edit(*next, removed);
+        for (Food* food : removed) food->leaveMenu();
+        next->version = old->version + 1;
+        current.store(next);
+        retired.push_back({old, removed, global_epoch.fetch_add(1)});
+        reclaim();
+    }
+
+    long getVersion() { return read()->version; }
+    long getReclaimedCount() { lock_guard<mutex> lock(write_lock); return reclaimed; }
+    size_t getRetiredCount() { lock_guard<mutex> lock(write_lock); return retired.size(); }
+};
+MenuStore menuStore;
+
+void onMenuChanged();   // drops the stale menu rendering, defined with it
+
+// false when the id is already on the menu; the food is then left to the caller
+bool addToManageFood(Food* food) {
+    if (food == nullptr) return false;
+    bool added = false;
+    menuStore.update([&](MenuVersion& v, vector<Food*>&) {
+        added = v.foods.emplace(food->getId(), food).second;
+        if (!added) return;
+        food->adoptByMenu();
+        menuAvailability.addFood(food);
+    });
+    if (!added) {
+        LOG_WARN("food id {} is already on the menu", food->getId());
+        return false;
+    }
+    onMenuChanged();
+    return true;
+}
+
+// publishes a whole batch as one version instead of one version per food;
+// returns the foods refused because their id was already taken
+vector<Food*> addFoodsToMenu(const vector<Food*>& foods) {
+    vector<Food*> refused;
+    if (foods.empty()) return refused;
+    menuStore.update([&](MenuVersion& v, vector<Food*>&) {
+        for (Food* food : foods) {
+            if (food == nullptr) continue;
+            if (!v.foods.emplace(food->getId(), food).second) {
+                refused.push_back(food);
+                continue;
+            }
+            food->adoptByMenu();
+            menuAvailability.addFood(food);
+        }
+    });
+    if (!refused.empty()) LOG_WARN("{} foods refused, their ids are already on the menu", refused.size());
+    onMenuChanged();
+    return refused;
+}
+
+// the food is freed once no guest can still be reading it and no order or
+// combo holds it
+void removeFood(string id) {
+    bool found = false;
+    menuStore.update([&](MenuVersion& v, vector<Food*>& removed) {
+        auto it = v.foods.find(id);
+        if (it != v.foods.end()) {
+            removed.push_back(it->second);
+            v.foods.erase(it);
+            found = true;
+        }
+    });
+    if (found) {
+        menuAvailability.removeFood(id);
+        onMenuChanged();
+    }
+    if (found) LOG_INFO("food {} removed from the menu", id);
+    else LOG_WARN("food {} not found for removal", id);
+}
+
+// pinned while the reader is still active, so the food outlives a removal
+FoodRef findFoodById(string_view id) {
+    static const CallMetric lookups = metrics.callMetric("menu_find_food", "Menu lookups by food id");
+    MetricScope measured(lookups);
+    auto menu = menuStore.read();
+    auto it = menu->foods.find(id);
+    return (it != menu->foods.end()) ? FoodRef(it->second) : FoodRef();
+}
+
+// -------------------- Combo --------------------
+class Combo : public SlabObject {
+private:
+    vector<FoodRef> FoodHavecombo;
+    string combo_id;
+    string combo_name;
+    double price;
+    double discount;
+
+public:
+    inline static atomic<int> combo_cnt{0};
+    Combo(string _combo_name, double _discount = 0.1, NotificationManager& notifier = notificationManager)
+        : combo_name(_combo_name), discount(_discount) {
+        int number = ++combo_cnt;
+        stringstream ss;
+        ss << "C" << setw(3) << setfill('0') << number;
+        combo_id = ss.str();
+        price = 0.0;
+        notifier.sendNewCombo(_combo_name, _discount); //new combo notification
+    }
+
+    void addFood(Food* food) {
+        if (food != nullptr) {
+            FoodHavecombo.push_back(food);
+            calculatePrice();
+        }
+    }
+
+    void removeFood(string food_id) {
+        for (auto it = FoodHavecombo.begin(); it != FoodHavecombo.end(); ++it) {
+            Food* food = it->get();
+            if (food != nullptr && food->getId() == food_id) {
+                FoodHavecombo.erase(it);
+                calculatePrice();
                 break;
             }
         }
@@ -346,627 +1825,5755 @@ public:
 
     void calculatePrice() {
         double total = 0.0;
-        for (Food* food : FoodHavecombo) {
+        for (Food* food : getFoodItems()) {
             total += food->getPrice();
         }
         price = total * (1.0 - discount);
     }
 
-    void display() {
-        cout << "=== Combo Details ===" << endl;
-        cout << "Combo ID: " << combo_id << endl;
-        cout << "Combo Name: " << combo_name << endl;
-        cout << "Discount: " << (discount * 100) << "%" << endl;
-        cout << "Items in combo:" << endl;
+    // false once one of its foods has been removed from the menu
+    bool isComplete() {
+        for (auto& ref : FoodHavecombo) {
+            if (ref.isOffMenu()) return false;
+        }
+        return true;
+    }
+
+    void display(ostream& out = cout) {
+        out << "=== Combo Details ===" << endl;
+        out << "Combo ID: " << combo_id << endl;
+        out << "Combo Name: " << combo_name << endl;
+        out << "Discount: " << (discount * 100) << "%" << endl;
+        out << "Items in combo:" << endl;
 
         double original_total = 0.0;
-        for (Food* food : FoodHavecombo) {
-            cout << "  - ";
-            food->display();
+        for (Food* food : getFoodItems()) {
+            out << "  - ";
+            food->display(out);
             original_total += food->getPrice();
         }
+        if (!isComplete()) out << "  (some items are no longer on the menu)" << endl;
 
-        cout << "Original Total: $" << fixed << setprecision(2) << original_total << endl;
-        cout << "Discounted Price: $" << fixed << setprecision(2) << price << endl;
-        cout << "You Save: $" << fixed << setprecision(2) << (original_total - price) << endl;
-        cout << "========================" << endl;
+        out << "Original Total: $" << fixed << setprecision(2) << original_total << endl;
+        out << "Discounted Price: $" << fixed << setprecision(2) << price << endl;
+        out << "You Save: $" << fixed << setprecision(2) << (original_total - price) << endl;
+        out << "========================" << endl;
     }
 
     string getComboId() { return combo_id; }
+    void setComboId(string _id) { combo_id = _id; }
     string getComboName() { return combo_name; }
     double getPrice() { return price; }
-    vector<Food*> getFoodItems() { return FoodHavecombo; }
+    double getDiscount() { return discount; }
+    vector<Food*> getFoodItems() {
+        vector<Food*> items;
+        for (auto& ref : FoodHavecombo) {
+            if (Food* food = ref.get()) items.push_back(food);
+        }
+        return items;
+    }
 };
+Slab<Combo> comboSlab;
 
-// -------------------- User --------------------
-class User {
-protected:
-    string username;
-    string password;
-    string id;
+// combos live in the same versioned menu as the foods
+class ComboManager {
 public:
-    User(string _username, string _password){
-        username = _username;
-        password = _password;
+    // false when the id is already on the menu; the combo is then left to the caller
+    bool addCombo(Combo* combo) {
+        if (combo == nullptr) return false;
+        bool added = false;
+        menuStore.update([&](MenuVersion& v, vector<Food*>&) {
+            added = v.combos.emplace(combo->getComboId(), combo).second;
+            if (added) menuAvailability.addCombo(combo->getComboId(), combo->getFoodItems());
+        });
+        if (!added) {
+            LOG_WARN("combo id {} is already on the menu", combo->getComboId());
+            return false;
+        }
+        onMenuChanged();
+        return true;
     }
 
-    string getId(){ return id; }
-    string getUsername(){ return username; }
-    string getPassword(){ return password; }
+    // one version for the whole batch; returns the combos refused because their id was taken
+    vector<Combo*> addCombos(const vector<Combo*>& combos) {
+        vector<Combo*> refused;
+        if (combos.empty()) return refused;
+        menuStore.update([&](MenuVersion& v, vector<Food*>&) {
+            for (Combo* combo : combos) {
+                if (!v.combos.emplace(combo->getComboId(), combo).second) refused.push_back(combo);
+                else menuAvailability.addCombo(combo->getComboId(), combo->getFoodItems());
+            }
+        });
+        if (!refused.empty()) LOG_WARN("{} combos refused, their ids are already on the menu", refused.size());
+        onMenuChanged();
+        return refused;
+    }
 
-    void setId(string _id){ id = _id; }
-    void setUsername(string _username){ username = _username; }
-    void setPassword(string _password){ password = _password; }
+    void removeCombo(const string& combo_id) {
+        menuStore.update([&](MenuVersion& v, vector<Food*>&) { v.combos.erase(combo_id); });
+        menuAvailability.removeCombo(combo_id);
+        onMenuChanged();
+    }
 
-    virtual bool login(string _username, string _password) = 0;
-    virtual string getRole() = 0;
-    virtual ~User() {}
-};
+    void displayAllCombos(ostream& out = cout);
 
-class Guest : public User {
-private:
-    string role;
-    inline static int cnt = 0;
-public:
-    Guest(string _username, string _password) : User(_username, _password){
-        role = "Guest";
-        cnt++;
-        stringstream ss;
-        ss << "G" << setw(3) << setfill('0') << cnt;
-        id = ss.str();
+    // Combos are never freed by the menu store (their creator owns them) and
+    // they pin their foods, so the pointers stay valid after the read ends.
+    Combo* findComboById(string_view id) {
+        auto menu = menuStore.read();
+        auto it = menu->combos.find(id);
+        return (it != menu->combos.end()) ? it->second : nullptr;
     }
 
-    string getRole() override { return role; }
-
-    bool login(string _username, string _password) override {
-        return (username == _username && password == _password);
+    vector<Combo*> getAllCombos() {
+        auto menu = menuStore.read();
+        vector<Combo*> combos;
+        for (auto& pair : menu->combos) {
+            combos.push_back(pair.second);
+        }
+        return combos;
     }
 };
+ComboManager comboManager;
 
-class Staff : public User {
-private:
-    string role;
-    inline static int cnt = 0;
-public:
-    Staff(string _username, string _password) : User(_username, _password){
-        role = "Staff";
-        cnt++;
-        stringstream ss;
-        ss << "S" << setw(3) << setfill('0') << cnt;
-        id = ss.str();
+// -------------------- Menu Cache --------------------
+// The formatted menu (console text and JSON) is rendered once per change and
+// published as an immutable buffer; showing the menu is then a single write.
+// Catalog edits only drop the stale rendering through onMenuChanged, and a
+// sold-out edge only bumps the availability generation; either way the next
+// reader re-renders, so adding foods one at a time costs one render, not one each.
+string jsonEscape(const string& text) {
+    string out;
+    out.reserve(text.size() + 2);
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if ((unsigned char)ch < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+            out += buffer;
+        } else out += ch;
     }
+    return out;
+}
 
-    string getRole() override { return role; }
+string jsonMoney(double amount) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2f", amount);
+    return buffer;
+}
 
-    bool login(string _username, string _password) override {
-        return (username == _username && password == _password);
-    }
+struct MenuRendering {
+    long version = -1;
+    long generation = -1;
+    string food_text;
+    string combo_text;
+    string json;
 };
 
-// -------------------- Account Manager --------------------
-class AccountManager {
+class MenuCache {
 private:
-    map<string, User*> guests;   // chỉ quản lý Guest
-    Staff* staffAccount;         // 1 staff duy nhất
+    shared_ptr<const MenuRendering> current;
+    mutex build_lock;
+    atomic<long> renders{0};
+
+    static void render(MenuRendering& r) {
+        auto menu = menuStore.read();
+        ostringstream foods;
+        foods << "=== All Available Food Items ===\n";
+        r.json = "{\"version\":" + to_string(menu->version) + ",\"foods\":[";
+        bool first = true;
+        for (auto& pair : menu->foods) {
+            if (!menuAvailability.isFoodVisible(pair.first)) continue;
+            Food* food = pair.second;
+            food->display(foods);
+            if (!first) r.json += ',';
+            first = false;
+            r.json += "{\"id\":\"" + jsonEscape(food->getId()) + "\",\"type\":\"" + food->getType()
+                      + "\",\"name\":\"" + jsonEscape(food->getName()) + "\",\"price\":" + jsonMoney(food->getPrice()) + "}";
+        }
+        foods << "===============================\n";
+        r.food_text = foods.str();
+
+        ostringstream combos;
+        if (menu->combos.empty()) combos << "  No combos available.\n";
+        else combos << "\n===  All Available Combos ===\n";
+        r.json += "],\"combos\":[";
+        first = true;
+        for (auto& pair : menu->combos) {
+            if (!menuAvailability.isComboVisible(pair.first)) continue;
+            Combo* combo = pair.second;
+            combo->display(combos);
+            combos << "-------------------------------\n";
+            if (!first) r.json += ',';
+            first = false;
+            r.json += "{\"id\":\"" + jsonEscape(combo->getComboId()) + "\",\"name\":\"" + jsonEscape(combo->getComboName())
+                      + "\",\"price\":" + jsonMoney(combo->getPrice()) + ",\"foods\":[";
+            vector<Food*> items = combo->getFoodItems();
+            for (size_t i = 0; i < items.size(); i++) {
+                if (i > 0) r.json += ',';
+                r.json += "\"" + jsonEscape(items[i]->getId()) + "\"";
+            }
+            r.json += "]}";
+        }
+        if (!menu->combos.empty()) combos << "===============================\n";
+        r.combo_text = combos.str();
+        r.json += "]}";
+    }
+
+    static bool isCurrent(const shared_ptr<const MenuRendering>& r, long version, long generation) {
+        return r && r->version == version && r->generation == generation;
+    }
+
 public:
-    AccountManager(){
-        // tạo staff mặc định
-        staffAccount = new Staff("admin", "123");
+    // the rendering for the current menu, re-rendered first if it is stale
+    shared_ptr<const MenuRendering> get() {
+        long version = menuStore.getVersion();
+        long generation = menuAvailability.getGeneration();
+        shared_ptr<const MenuRendering> cached = atomic_load(&current);
+        if (isCurrent(cached, version, generation)) return cached;
+        lock_guard<mutex> lock(build_lock);
+        cached = atomic_load(&current);
+        if (isCurrent(cached, version, generation)) return cached;
+        shared_ptr<MenuRendering> next = make_shared<MenuRendering>();
+        next->version = version;
+        next->generation = generation;
+        render(*next);
+        renders++;
+        atomic_store(&current, shared_ptr<const MenuRendering>(next));
+        return next;
     }
 
-    ~AccountManager(){
-        for(auto &p : guests){
-            delete p.second;
+    // shares ownership with the rendering, so the buffer stays valid while it is sent
+    shared_ptr<const string> json() {
+        shared_ptr<const MenuRendering> r = get();
+        return shared_ptr<const string>(r, &r->json);
+    }
+
+    // frees the stale buffer early; get() would notice the new version anyway
+    void invalidate() { atomic_store(&current, shared_ptr<const MenuRendering>()); }
+
+    long getRenderCount() { return renders.load(); }
+};
+MenuCache menuCache;
+
+void onMenuChanged() {
+    menuCache.invalidate();
+}
+
+void displayAllFood(ostream& out = cout) {
+    shared_ptr<const MenuRendering> menu = menuCache.get();
+    out << menu->food_text << flush;
+}
+
+void ComboManager::displayAllCombos(ostream& out) {
+    shared_ptr<const MenuRendering> menu = menuCache.get();
+    out << menu->combo_text << flush;
+}
+
+// -------------------- Menu Search --------------------
+// A SearchIndex is an immutable snapshot of the foods it was built from:
+//  - every word of a food's name, type and attributes (broth, protein,
+//    category, ...) is a term with a posting list of the foods using it
+//  - terms sit in a trie in sorted order, so a half-typed word maps to one
+//    node whose subtree is a contiguous range of term ids
+//  - a word with no exact term falls back to the terms within a small edit
+//    distance, found by walking the trie with one Levenshtein row per level
+// MenuSearch keeps an index of the live menu, rebuilt when the menu changes.
+struct SearchQuery {
+    string text;
+    string type;                  // "ramen", "drink", ... or empty for any
+    bool vegetarian_only = false;
+    double max_price = 0.0;       // 0 for no limit
+    size_t limit = 10;
+};
+
+struct SearchHit {
+    string id;
+    string name;
+    string type;
+    double price;
+    int distance;   // edits needed to match the typed words
+};
+
+class SearchIndex {
+private:
+    struct Doc {
+        string id;
+        string name;
+        string type;
+        double price;
+        bool vegetarian;
+        vector<uint32_t> terms;   // sorted term ids
+    };
+
+    struct TrieNode {
+        vector<pair<char, uint32_t>> children;   // sorted by character
+        int32_t term = -1;
+        uint32_t first_term = 0;                 // subtree covers [first_term, end_term)
+        uint32_t end_term = 0;
+        vector<uint32_t> top;                    // first docs in the subtree, for short prefixes
+    };
+
+    // one typed word, resolved against the vocabulary
+    struct Constraint {
+        bool is_range = false;
+        uint32_t node = 0;
+        uint32_t lo = 0, hi = 0;                  // prefix: term ids in [lo, hi)
+        vector<pair<uint32_t, int>> fuzzy;       // exact or fuzzy: (term, distance), sorted by term
+        size_t estimate = 0;                     // postings it can reach
+    };
+
+    long version;
+    vector<Doc> docs;                  // sorted by name
+    vector<string> terms;              // sorted, term id = position
+    vector<vector<uint32_t>> postings; // per term, sorted doc ids
+    vector<size_t> posting_prefix;     // posting_prefix[t] = postings before term t
+    vector<TrieNode> trie;
+    size_t longest_term = 0;
+
+    static const size_t TOP_DOCS = 32;
+    static const size_t TOP_DEPTH = 3;   // one to three typed letters match the most terms
+
+    static void tokenize(const string& text, vector<string>& out) {
+        string word;
+        for (char ch : text) {
+            if (isalnum((unsigned char)ch)) word += (char)tolower((unsigned char)ch);
+            else if (!word.empty()) {
+                out.push_back(word);
+                word.clear();
+            }
+        }
+        if (!word.empty()) out.push_back(word);
+    }
+
+    static int maxEdits(size_t length) { return length >= 6 ? 2 : length >= 3 ? 1 : 0; }
+
+    uint32_t child(uint32_t node, char ch) const {
+        const vector<pair<char, uint32_t>>& children = trie[node].children;
+        auto it = lower_bound(children.begin(), children.end(), make_pair(ch, (uint32_t)0));
+        return it != children.end() && it->first == ch ? it->second : 0;
+    }
+
+    // 0 when no term starts with the prefix (the root is never a match)
+    uint32_t findNode(const string& prefix) const {
+        uint32_t node = 0;
+        for (char ch : prefix) {
+            node = child(node, ch);
+            if (node == 0) return 0;
+        }
+        return node;
+    }
+
+    void fuzzyWalk(uint32_t node, char ch, const string& word, int limit, vector<vector<int>>& rows, size_t depth,
+                   vector<pair<uint32_t, int>>& out) const {
+        const vector<int>& prev = rows[depth - 1];
+        vector<int>& row = rows[depth];
+        row[0] = prev[0] + 1;
+        int best = row[0];
+        for (size_t i = 1; i <= word.size(); i++) {
+            row[i] = min({row[i - 1] + 1, prev[i] + 1, prev[i - 1] + (word[i - 1] != ch)});
+            best = min(best, row[i]);
+        }
+        if (trie[node].term >= 0 && row[word.size()] <= limit) out.push_back({(uint32_t)trie[node].term, row[word.size()]});
+        if (best > limit) return;
+        for (auto& next : trie[node].children) fuzzyWalk(next.second, next.first, word, limit, rows, depth + 1, out);
+    }
+
+    vector<pair<uint32_t, int>> fuzzyTerms(const string& word) const {
+        vector<pair<uint32_t, int>> found;
+        int limit = maxEdits(word.size());
+        vector<vector<int>> rows(longest_term + 1, vector<int>(word.size() + 1));   // one row per trie level
+        for (size_t i = 0; i <= word.size(); i++) rows[0][i] = (int)i;
+        for (auto& next : trie[0].children) fuzzyWalk(next.second, next.first, word, limit, rows, 1, found);
+        sort(found.begin(), found.end());
+        return found;
+    }
+
+    void fillTop(uint32_t node, size_t depth) {
+        if (depth > TOP_DEPTH) return;
+        if (depth > 0) {
+            vector<uint32_t>& top = trie[node].top;
+            for (uint32_t t = trie[node].first_term; t < trie[node].end_term; t++) {
+                size_t take = min(TOP_DOCS, postings[t].size());
+                top.insert(top.end(), postings[t].begin(), postings[t].begin() + take);
+                sort(top.begin(), top.end());
+                top.erase(unique(top.begin(), top.end()), top.end());
+                if (top.size() > TOP_DOCS) top.resize(TOP_DOCS);
+            }
+        }
+        for (auto& next : trie[node].children) fillTop(next.second, depth + 1);
+    }
+
+    Constraint resolve(const string& word, bool prefix) const {
+        Constraint c;
+        uint32_t node = findNode(word);
+        if (node != 0 && prefix) {
+            c.is_range = true;
+            c.node = node;
+            c.lo = trie[node].first_term;
+            c.hi = trie[node].end_term;
+            c.estimate = posting_prefix[c.hi] - posting_prefix[c.lo];
+            return c;
+        }
+        if (node != 0 && trie[node].term >= 0) c.fuzzy.push_back({(uint32_t)trie[node].term, 0});
+        else c.fuzzy = fuzzyTerms(word);
+        for (auto& t : c.fuzzy) c.estimate += postings[t.first].size();
+        return c;
+    }
+
+    // edits needed for the doc to satisfy the constraint, -1 if it cannot
+    static int distanceFor(const Doc& doc, const Constraint& c) {
+        if (c.is_range) {
+            auto it = lower_bound(doc.terms.begin(), doc.terms.end(), c.lo);
+            return it != doc.terms.end() && *it < c.hi ? 0 : -1;
+        }
+        int best = -1;
+        size_t i = 0, j = 0;
+        while (i < doc.terms.size() && j < c.fuzzy.size()) {
+            if (doc.terms[i] < c.fuzzy[j].first) i++;
+            else if (c.fuzzy[j].first < doc.terms[i]) j++;
+            else {
+                if (best < 0 || c.fuzzy[j].second < best) best = c.fuzzy[j].second;
+                i++;
+                j++;
+            }
+        }
+        return best;
+    }
+
+    // fewest edits first, then by name
+    static vector<SearchHit>& finish(vector<SearchHit>& hits, size_t limit) {
+        stable_sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) { return a.distance < b.distance; });
+        if (hits.size() > limit) hits.resize(limit);
+        return hits;
+    }
+
+public:
+    SearchIndex(const vector<Food*>& foods, long _version = 0) : version(_version) {
+        vector<pair<string, Food*>> by_name;
+        by_name.reserve(foods.size());
+        for (Food* food : foods) by_name.push_back({food->getName(), food});
+        sort(by_name.begin(), by_name.end(), [](const pair<string, Food*>& a, const pair<string, Food*>& b) { return a.first < b.first; });
+
+        unordered_map<string, vector<uint32_t>> by_term;
+        docs.resize(by_name.size());
+        vector<string> doc_words;
+        for (uint32_t d = 0; d < by_name.size(); d++) {
+            Food* food = by_name[d].second;
+            Doc& doc = docs[d];
+            doc.id = food->getId();
+            doc.name = by_name[d].first;
+            doc.type = food->getType();
+            doc.price = food->getPrice();
+            vector<string> fields = food->getFields();
+            if (doc.type == "side_dish" && fields.size() > 1) {
+                doc.vegetarian = fields[1] == "1";
+                fields.pop_back();   // the flag is indexed as the word "vegetarian"
+            } else {
+                doc.vegetarian = false;
+            }
+
+            doc_words.clear();
+            tokenize(doc.name, doc_words);
+            tokenize(doc.type, doc_words);
+            tokenize(doc.id, doc_words);
+            for (const string& field : fields) tokenize(field, doc_words);
+            if (doc.vegetarian) doc_words.push_back("vegetarian");
+            sort(doc_words.begin(), doc_words.end());
+            doc_words.erase(unique(doc_words.begin(), doc_words.end()), doc_words.end());
+            for (const string& w : doc_words) by_term[w].push_back(d);
+        }
+        terms.reserve(by_term.size());
+        for (auto& pair : by_term) terms.push_back(pair.first);
+        sort(terms.begin(), terms.end());
+        postings.resize(terms.size());
+        posting_prefix.assign(terms.size() + 1, 0);
+        trie.emplace_back();
+        for (uint32_t t = 0; t < terms.size(); t++) {
+            postings[t] = move(by_term[terms[t]]);
+            longest_term = max(longest_term, terms[t].size());
+            posting_prefix[t + 1] = posting_prefix[t] + postings[t].size();
+            for (uint32_t d : postings[t]) docs[d].terms.push_back(t);   // ids arrive in order, so stays sorted
+            uint32_t node = 0;
+            trie[0].end_term = t + 1;
+            for (char ch : terms[t]) {
+                uint32_t next = child(node, ch);
+                if (next == 0) {
+                    next = (uint32_t)trie.size();
+                    trie.emplace_back();
+                    trie[next].first_term = t;
+                    trie[node].children.push_back({ch, next});   // sorted insertion keeps children sorted
+                }
+                node = next;
+                trie[node].end_term = t + 1;
+            }
+            trie[node].term = (int32_t)t;
+        }
+        fillTop(0, 0);
+    }
+
+    // visible is asked only about foods that already match, in result order
+    vector<SearchHit> search(const SearchQuery& query, const function<bool(const string&)>& visible = nullptr) const {
+        vector<SearchHit> hits;
+        vector<string> words;
+        tokenize(query.text, words);
+        bool typing = !query.text.empty() && isalnum((unsigned char)query.text.back());
+        vector<Constraint> constraints;
+        for (size_t i = 0; i < words.size(); i++) {
+            constraints.push_back(resolve(words[i], typing && i + 1 == words.size()));
+            if (constraints.back().estimate == 0) return hits;
+        }
+
+        // no hit can need fewer edits than this, so the scan stops once it has enough of them
+        int floor = 0;
+        for (const Constraint& c : constraints) {
+            if (c.is_range) continue;
+            int closest = c.fuzzy[0].second;   // fuzzy is in term order, not by distance
+            for (auto& term : c.fuzzy) closest = min(closest, term.second);
+            floor += closest;
+        }
+        size_t at_floor = 0;
+
+        auto accept = [&](uint32_t d) {
+            const Doc& doc = docs[d];
+            if (!query.type.empty() && doc.type != query.type) return;
+            if (query.vegetarian_only && !doc.vegetarian) return;
+            if (query.max_price > 0.0 && doc.price > query.max_price) return;
+            int distance = 0;
+            for (const Constraint& c : constraints) {
+                int edits = distanceFor(doc, c);
+                if (edits < 0) return;
+                distance += edits;
+            }
+            if (visible && !visible(doc.id)) return;
+            hits.push_back({doc.id, doc.name, doc.type, doc.price, distance});
+            if (distance == floor) at_floor++;
+        };
+        auto full = [&]() { return at_floor >= query.limit; };
+        auto scan = [&](const vector<uint32_t>& list) {
+            for (size_t i = 0; i < list.size() && !full(); i++) accept(list[i]);
+        };
+
+        // drive the scan from the most selective word; merging several lists costs extra
+        const Constraint* driver = nullptr;
+        size_t driver_cost = 0;
+        for (const Constraint& c : constraints) {
+            bool single = c.is_range ? c.hi - c.lo == 1 : c.fuzzy.size() == 1;
+            size_t cost = single ? c.estimate : c.estimate * 2;
+            if (driver == nullptr || cost < driver_cost) {
+                driver = &c;
+                driver_cost = cost;
+            }
+        }
+        if (driver != nullptr && driver->is_range && !trie[driver->node].top.empty()) {
+            scan(trie[driver->node].top);
+            if (full()) return finish(hits, query.limit);
+            hits.clear();
+            at_floor = 0;
+        }
+        if (driver == nullptr || driver->estimate > docs.size() / 8) {
+            for (uint32_t d = 0; d < docs.size() && !full(); d++) accept(d);
+        } else if (driver->is_range && driver->hi - driver->lo == 1) {
+            scan(postings[driver->lo]);
+        } else if (!driver->is_range && driver->fuzzy.size() == 1) {
+            scan(postings[driver->fuzzy[0].first]);
+        } else {
+            vector<uint32_t> candidates;
+            if (driver->is_range) {
+                for (uint32_t t = driver->lo; t < driver->hi; t++) candidates.insert(candidates.end(), postings[t].begin(), postings[t].end());
+            } else {
+                for (auto& t : driver->fuzzy) candidates.insert(candidates.end(), postings[t.first].begin(), postings[t.first].end());
+            }
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+            scan(candidates);
+        }
+        return finish(hits, query.limit);
+    }
+
+    long getVersion() const { return version; }
+    size_t getDocCount() const { return docs.size(); }
+    size_t getTermCount() const { return terms.size(); }
+};
+
+class MenuSearch {
+private:
+    shared_ptr<const SearchIndex> current;
+    mutex build_lock;
+
+public:
+    // the index of the current menu, rebuilt first if the menu has changed
+    shared_ptr<const SearchIndex> snapshot() {
+        long version = menuStore.getVersion();
+        shared_ptr<const SearchIndex> index = atomic_load(&current);
+        if (index && index->getVersion() == version) return index;
+        lock_guard<mutex> lock(build_lock);
+        index = atomic_load(&current);
+        if (index && index->getVersion() == version) return index;
+        vector<Food*> foods;
+        {
+            auto menu = menuStore.read();
+            version = menu->version;
+            for (auto& pair : menu->foods) foods.push_back(pair.second);
+            index = make_shared<const SearchIndex>(foods, version);
+        }
+        atomic_store(&current, index);
+        return index;
+    }
+
+    // sold-out foods are left out
+    vector<SearchHit> search(const SearchQuery& query) {
+        return snapshot()->search(query, [](const string& id) { return menuAvailability.isFoodVisible(id); });
+    }
+
+    void displayResults(const string& text, ostream& out = cout) {
+        SearchQuery query;
+        query.text = text;
+        vector<SearchHit> hits = search(query);
+        if (hits.empty()) {
+            out << "No dishes match \"" << text << "\"." << endl;
+            return;
+        }
+        out << "=== Search Results ===" << endl;
+        for (SearchHit& hit : hits) {
+            out << "ID: " << hit.id << ", " << hit.name << " (" << hit.type << "), Price: $" << fixed << setprecision(2)
+                 << hit.price << (hit.distance > 0 ? "  [did you mean?]" : "") << endl;
+        }
+        out << "======================" << endl;
+    }
+};
+MenuSearch menuSearch;
+
+// -------------------- Combo Matcher --------------------
+// Finds the cheapest way to cover an order's food lines with existing combos.
+// Every distinct food in the order gets one bit, so a combo whose signature is
+// not a subset of the order signature is rejected with a single AND.
+struct ComboMatch {
+    Combo* combo;
+    vector<int> lines;   // indexes into the order's food lines
+};
+
+class ComboMatcher {
+private:
+    static const int MAX_KINDS = 64;        // distinct foods tracked per order
+    static const int SEARCH_BUDGET = 20000; // max search nodes per order
+
+    struct Candidate {
+        Combo* combo;
+        uint64_t signature;
+        vector<pair<int, int>> need;   // (food kind, count)
+        double savings;
+    };
+
+    vector<Candidate> candidates;
+    vector<int> available;      // remaining lines per food kind
+    vector<double> kind_price;
+    vector<int> chosen, best_chosen;
+    double best_savings;
+    int nodes;
+
+    uint64_t availableMask() {
+        uint64_t mask = 0;
+        for (size_t k = 0; k < available.size(); k++) {
+            if (available[k] > 0) mask |= (1ULL << k);
+        }
+        return mask;
+    }
+
+    bool fits(const Candidate& c, uint64_t mask) {
+        if ((c.signature & mask) != c.signature) return false;
+        for (auto& n : c.need) {
+            if (available[n.first] < n.second) return false;
+        }
+        return true;
+    }
+
+    void search(int start, double savings, double remaining_value) {
+        if (savings > best_savings) {
+            best_savings = savings;
+            best_chosen = chosen;
+        }
+        // savings can never exceed the full price of the lines still uncovered
+        if (++nodes > SEARCH_BUDGET || savings + remaining_value <= best_savings) return;
+
+        uint64_t mask = availableMask();
+        for (int i = start; i < (int)candidates.size() && nodes <= SEARCH_BUDGET; i++) {
+            Candidate& c = candidates[i];
+            if (!fits(c, mask)) continue;
+
+            double covered = 0.0;
+            for (auto& n : c.need) {
+                available[n.first] -= n.second;
+                covered += kind_price[n.first] * n.second;
+            }
+            chosen.push_back(i);
+            search(i, savings + c.savings, remaining_value - covered);
+            chosen.pop_back();
+            for (auto& n : c.need) available[n.first] += n.second;
+        }
+    }
+
+public:
+    vector<ComboMatch> findCheapest(vector<Food*> lines, vector<Combo*> combos) {
+        vector<ComboMatch> result;
+        map<string, int> kinds;
+        vector<int> line_kind(lines.size(), -1);
+        map<vector<pair<int, int>>, int> by_contents;
+
+        candidates.clear();
+        available.clear();
+        kind_price.clear();
+        double total_value = 0.0;
+
+        for (size_t i = 0; i < lines.size(); i++) {
+            string id = lines[i]->getId();
+            auto it = kinds.find(id);
+            if (it == kinds.end()) {
+                if ((int)kinds.size() == MAX_KINDS) continue; // beyond 64 kinds stays full price
+                it = kinds.emplace(id, (int)kinds.size()).first;
+                available.push_back(0);
+                kind_price.push_back(lines[i]->getPrice());
+            }
+            line_kind[i] = it->second;
+            available[it->second]++;
+            total_value += lines[i]->getPrice();
+        }
+
+        for (Combo* combo : combos) {
+            if (combo == nullptr || !combo->isComplete()) continue;
+            vector<Food*> items = combo->getFoodItems();
+            if (items.empty()) continue;
+
+            Candidate c{combo, 0, {}, 0.0};
+            double original = 0.0;
+            bool usable = true;
+            for (Food* food : items) {
+                auto it = kinds.find(food->getId());
+                if (it == kinds.end()) { usable = false; break; }
+                int k = it->second;
+                if (c.signature & (1ULL << k)) {
+                    for (auto& n : c.need) if (n.first == k) n.second++;
+                } else {
+                    c.signature |= (1ULL << k);
+                    c.need.push_back({k, 1});
+                }
+                original += food->getPrice();
+            }
+            if (!usable) continue;
+            c.savings = original - combo->getPrice();
+            if (c.savings <= 0.0 || !fits(c, availableMask())) continue;
+
+            // combos with the same contents compete for the same lines: keep the cheapest
+            sort(c.need.begin(), c.need.end());
+            auto same = by_contents.find(c.need);
+            if (same == by_contents.end()) {
+                by_contents[c.need] = (int)candidates.size();
+                candidates.push_back(c);
+            } else if (c.savings > candidates[same->second].savings) {
+                candidates[same->second] = c;
+            }
+        }
+
+        // try the biggest savings first so the budget is spent on good branches
+        sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.savings > b.savings;
+        });
+
+        chosen.clear();
+        best_chosen.clear();
+        best_savings = 0.0;
+        nodes = 0;
+        search(0, 0.0, total_value);
+
+        vector<bool> used(lines.size(), false);
+        for (int idx : best_chosen) {
+            ComboMatch match{candidates[idx].combo, {}};
+            for (Food* food : match.combo->getFoodItems()) {
+                int k = kinds[food->getId()];
+                for (size_t i = 0; i < lines.size(); i++) {
+                    if (!used[i] && line_kind[i] == k) {
+                        used[i] = true;
+                        match.lines.push_back((int)i);
+                        break;
+                    }
+                }
+            }
+            result.push_back(match);
+        }
+        return result;
+    }
+};
+
+// -------------------- Menu Import / Export --------------------
+// CSV rows, one item per line:
+//   food,<id>,<type>,<name>,<price>[,<subclass fields>...]
+//   combo,<id>,<name>,<discount>,<food id>;<food id>;...
+// Files are read line by line, so memory use does not grow with file size
+// beyond the catalog entries themselves.
+struct ImportStats {
+    long rows = 0;
+    long foods = 0;
+    long combos = 0;
+    long errors = 0;
+    double seconds = 0.0;
+
+    double rowsPerSecond() { return seconds > 0.0 ? rows / seconds : 0.0; }
+
+    void display() {
+        cout << "Imported " << foods << " foods and " << combos << " combos from "
+             << rows << " rows (" << errors << " errors) in "
+             << fixed << setprecision(3) << seconds << "s, "
+             << setprecision(0) << rowsPerSecond() << " rows/sec" << endl;
+    }
+};
+
+class MenuImporter {
+private:
+    size_t batch_size;
+    vector<Food*> batch;
+    vector<vector<string>> combo_rows;   // built once every food is on the menu
+    vector<string> fields;   // reused for every row
+    ImportStats stats;
+
+    void splitCsvLine(const string& line) {
+        size_t n = 0;
+        bool quoted = false;
+        if (fields.empty()) fields.emplace_back();
+        fields[0].clear();
+        for (size_t i = 0; i < line.size(); i++) {
+            char ch = line[i];
+            if (quoted) {
+                if (ch == '"' && i + 1 < line.size() && line[i + 1] == '"') { fields[n] += '"'; i++; }
+                else if (ch == '"') quoted = false;
+                else fields[n] += ch;
+            } else if (ch == '"') {
+                quoted = true;
+            } else if (ch == ',') {
+                if (++n == fields.size()) fields.emplace_back();
+                fields[n].clear();
+            } else if (ch != '\r') {
+                fields[n] += ch;
+            }
+        }
+        fields.resize(n + 1);
+    }
+
+    Food* createFood() {
+        if (fields.size() < 5) return nullptr;
+        const string& type = fields[2];
+        string name = fields[3];
+        double price = stod(fields[4]);
+        auto field = [&](size_t i, string def) { return i < fields.size() ? fields[i] : def; };
+
+        if (type == "rice_don") return foodSlab.make<rice_don>(name, price, field(5, "White Rice"), field(6, "Chicken"));
+        if (type == "ramen") return foodSlab.make<ramen>(name, price, field(5, "Tonkotsu"), field(6, "Thin"));
+        if (type == "topping") return foodSlab.make<topping>(name, price, field(5, "Vegetable"));
+        if (type == "side_dish") return foodSlab.make<SideDish>(name, price, field(5, "Appetizer"), field(6, "0") == "1");
+        if (type == "drink") return foodSlab.make<Drink>(name, price, field(5, ""));
+        if (type == "food") return foodSlab.make<Food>(name, price);
+        return nullptr;
+    }
+
+    // File ids are kept, so combo rows can refer to foods and an export
+    // imports back unchanged; the counter moves past them so new ids never collide.
+    static void keepFileId(atomic<int>& counter, const string& file_id) {
+        if (file_id.size() > 1 && isdigit((unsigned char)file_id[1])) {
+            int number = atoi(file_id.c_str() + 1);
+            int current = counter.load();
+            while (current < number && !counter.compare_exchange_weak(current, number)) {}
+        }
+    }
+
+    // a food whose id is already on the menu is an error row, never a replacement
+    void flush() {
+        for (Food* food : addFoodsToMenu(batch)) {
+            foodSlab.destroy(food);
+            stats.foods--;
+            stats.errors++;
+        }
+        batch.clear();
+    }
+
+    // nullptr when a food id is unknown, so a partial combo is never imported
+    Combo* createCombo() {
+        if (fields.size() < 5) return nullptr;
+        double discount = stod(fields[3]);
+        vector<FoodRef> items;
+        size_t start = 0;
+        const string& ids = fields[4];
+        while (start <= ids.size()) {
+            size_t end = ids.find(';', start);
+            if (end == string::npos) end = ids.size();
+            if (end > start) {
+                FoodRef food = findFoodById(ids.substr(start, end - start));
+                if (!food) return nullptr;
+                items.push_back(food);
+            }
+            start = end + 1;
+        }
+        if (items.empty()) return nullptr;
+        Combo* combo = comboSlab.make<Combo>(fields[2], discount);
+        combo->setComboId(fields[1]);
+        keepFileId(Combo::combo_cnt, fields[1]);
+        for (FoodRef& food : items) combo->addFood(food.get());
+        return combo;
+    }
+
+    // combo rows may name foods from anywhere in the file, so they wait for the
+    // last food batch and are then published together in one version
+    void addComboRows() {
+        vector<Combo*> combos;
+        for (vector<string>& row : combo_rows) {
+            fields.swap(row);
+            try {
+                Combo* combo = createCombo();
+                if (combo == nullptr) stats.errors++;
+                else combos.push_back(combo);
+            } catch (const exception&) {
+                stats.errors++; // bad discount
+            }
+        }
+        combo_rows.clear();
+        vector<Combo*> refused = comboManager.addCombos(combos);
+        for (Combo* combo : refused) comboSlab.destroy(combo);
+        stats.combos += (long)(combos.size() - refused.size());
+        stats.errors += (long)refused.size();
+    }
+
+public:
+    // every batch publishes a new menu version, which copies the whole menu,
+    // so batches are kept large
+    MenuImporter(size_t _batch_size = 65536) : batch_size(_batch_size) {
+        batch.reserve(batch_size);
+    }
+
+    ImportStats importCsv(istream& in) {
+        stats = ImportStats();
+        auto start = chrono::steady_clock::now();
+        string line;
+        while (getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            stats.rows++;
+            splitCsvLine(line);
+            try {
+                if (fields[0] == "food") {
+                    Food* food = createFood();
+                    if (food == nullptr) { stats.errors++; continue; }
+                    food->setId(fields[1]);
+                    keepFileId(Food::cnt, fields[1]);
+                    batch.push_back(food);
+                    stats.foods++;
+                    if (batch.size() >= batch_size) flush();
+                } else if (fields[0] == "combo") {
+                    combo_rows.push_back(fields);
+                } else {
+                    stats.errors++;
+                }
+            } catch (const exception&) {
+                stats.errors++; // bad number in price/discount
+            }
+        }
+        flush();
+        addComboRows();
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+    ImportStats importFile(string path) {
+        ifstream in(path);
+        if (!in) {
+            LOG_ERROR("cannot open menu file {}", path);
+            return ImportStats();
+        }
+        return importCsv(in);
+    }
+};
+
+class MenuExporter {
+private:
+    static void writeField(ostream& out, const string& value) {
+        if (value.find_first_of(",\"\n") == string::npos) {
+            out << value;
+            return;
+        }
+        out << '"';
+        for (char ch : value) {
+            if (ch == '"') out << '"';
+            out << ch;
+        }
+        out << '"';
+    }
+
+    // shortest text that parses back to the same double, whatever the stream's flags
+    static void writeNumber(ostream& out, double value) {
+        char buffer[32];
+        auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+        out.write(buffer, result.ptr - buffer);
+    }
+
+public:
+    static long exportCsv(ostream& out) {
+        long rows = 0;
+        out << "# food,id,type,name,price,fields... / combo,id,name,discount,food ids\n";
+        auto menu = menuStore.read();
+        for (auto& pair : menu->foods) {
+            Food* food = pair.second;
+            out << "food," << food->getId() << ',' << food->getType() << ',';
+            writeField(out, food->getName());
+            out << ',';
+            writeNumber(out, food->getPrice());
+            for (const string& f : food->getFields()) {
+                out << ',';
+                writeField(out, f);
+            }
+            out << '\n';
+            rows++;
+        }
+        for (auto& pair : menu->combos) {
+            Combo* combo = pair.second;
+            out << "combo," << combo->getComboId() << ',';
+            writeField(out, combo->getComboName());
+            out << ',';
+            writeNumber(out, combo->getDiscount());
+            out << ',';
+            vector<Food*> items = combo->getFoodItems();
+            for (size_t i = 0; i < items.size(); i++) {
+                if (i > 0) out << ';';
+                out << items[i]->getId();
+            }
+            out << '\n';
+            rows++;
+        }
+        return rows;
+    }
+
+    static long exportFile(string path) {
+        ofstream out(path);
+        if (!out) {
+            LOG_ERROR("cannot write menu file {}", path);
+            return 0;
+        }
+        return exportCsv(out);
+    }
+};
+
+// -------------------- User --------------------
+class User {
+protected:
+    string username;
+    string password;
+    string id;
+public:
+    User(string _username, string _password){
+        username = _username;
+        password = _password;
+    }
+
+    string getId(){ return id; }
+    string getUsername(){ return username; }
+    string getPassword(){ return password; }
+
+    void setId(string _id){ id = _id; }
+    void setUsername(string _username){ username = _username; }
+    void setPassword(string _password){ password = _password; }
+
+    virtual bool login(string _username, string _password) = 0;
+    virtual string getRole() = 0;
+    virtual ~User() {}
+};
+
+class Guest : public User {
+private:
+    string role;
+    inline static atomic<int> cnt{0};
+public:
+    Guest(string _username, string _password) : User(_username, _password){
+        role = "Guest";
+        int number = ++cnt;
+        stringstream ss;
+        ss << "G" << setw(3) << setfill('0') << number;
+        id = ss.str();
+    }
+
+    string getRole() override { return role; }
+
+    bool login(string _username, string _password) override {
+        return (username == _username && password == _password);
+    }
+};
+
+// -------------------- Staff Roles --------------------
+// One bit per admin action, so a check is a single AND against the role's mask.
+enum StaffPermission : uint32_t {
+    PERM_VIEW_MENU = 1u << 0,
+    PERM_VIEW_ORDERS = 1u << 1,
+    PERM_UPDATE_ORDER = 1u << 2,
+    PERM_VIEW_RESERVATIONS = 1u << 3,
+    PERM_UPDATE_RESERVATION = 1u << 4,
+    PERM_SEND_PROMOTION = 1u << 5,
+    PERM_VIEW_PAYMENTS = 1u << 6,
+    PERM_REFUND = 1u << 7,
+    PERM_REPORTS = 1u << 8,
+    PERM_KITCHEN = 1u << 9,
+    PERM_MANAGE_STAFF = 1u << 10,
+    PERM_ALL = (1u << 11) - 1
+};
+
+enum class StaffRoleId { Cashier, Kitchen, Manager };
+
+// Lives at a fixed address for the manager's lifetime; staff point at it, so
+// editing the mask or repointing a staff member takes effect on the next check.
+struct StaffRole {
+    string name;
+    atomic<uint32_t> permissions;
+
+    StaffRole(string _name, uint32_t _permissions) : name(move(_name)), permissions(_permissions) {}
+};
+
+class Staff : public User {
+private:
+    string role;
+    inline static atomic<int> cnt{0};
+    inline static StaffRole unrestricted{"Unrestricted", PERM_ALL};
+    atomic<StaffRole*> staff_role;
+public:
+    Staff(string _username, string _password, StaffRole* _staff_role = &unrestricted)
+        : User(_username, _password), staff_role(_staff_role) {
+        role = "Staff";
+        int number = ++cnt;
+        stringstream ss;
+        ss << "S" << setw(3) << setfill('0') << number;
+        id = ss.str();
+    }
+
+    string getRole() override { return role; }
+
+    bool login(string _username, string _password) override {
+        return (username == _username && password == _password);
+    }
+
+    bool can(uint32_t permission) const {
+        return (staff_role.load(memory_order_acquire)->permissions.load(memory_order_acquire) & permission) == permission;
+    }
+
+    StaffRole* getStaffRole() const { return staff_role.load(memory_order_acquire); }
+    void setStaffRole(StaffRole* _staff_role) { staff_role.store(_staff_role, memory_order_release); }
+};
+
+// whether the account is staff holding the permission
+bool staffCan(User* user, uint32_t permission) {
+    Staff* staff = dynamic_cast<Staff*>(user);
+    return staff != nullptr && staff->can(permission);
+}
+
+// -------------------- Account Manager --------------------
+class AccountManager {
+private:
+    map<string, User*> guests;   // chỉ quản lý Guest
+    map<string, Staff*> staff;
+    StaffRole roles[3] = {
+        {"Cashier", PERM_VIEW_MENU | PERM_VIEW_ORDERS | PERM_UPDATE_ORDER | PERM_VIEW_RESERVATIONS |
+                    PERM_UPDATE_RESERVATION | PERM_VIEW_PAYMENTS},
+        {"Kitchen", PERM_VIEW_MENU | PERM_VIEW_ORDERS | PERM_UPDATE_ORDER | PERM_KITCHEN},
+        {"Manager", PERM_ALL},
+    };
+
+    User* find(const string& username){
+        auto s = staff.find(username);
+        if(s != staff.end()) return s->second;
+        auto it = guests.find(username);
+        return it != guests.end() ? it->second : nullptr;
+    }
+public:
+    AccountManager(){
+        // tạo staff mặc định
+        addStaff("admin", "123", StaffRoleId::Manager);
+    }
+
+    ~AccountManager(){
+        for(auto &p : guests){
+            delete p.second;
+        }
+        for(auto &p : staff){
+            delete p.second;
+        }
+    }
+
+    // Đăng ký Guest
+    bool registerGuest(string username, string password){
+        if(find(username) != nullptr){ // đã tồn tại
+            LOG_WARN("guest registration rejected, {} is taken", username);
+            return false;
+        }
+        User* guest = new Guest(username, password);
+        guests[username] = guest;
+        LOG_INFO("guest {} registered as {}", username, guest->getId());
+        return true;
+    }
+
+    bool addStaff(string username, string password, StaffRoleId role){
+        if(find(username) != nullptr) return false;
+        staff[username] = new Staff(username, password, &getRole(role));
+        return true;
+    }
+
+    Staff* findStaff(const string& username){
+        auto it = staff.find(username);
+        return it != staff.end() ? it->second : nullptr;
+    }
+
+    bool setStaffRole(const string& username, StaffRoleId role){
+        Staff* member = findStaff(username);
+        if(member == nullptr) return false;
+        member->setStaffRole(&getRole(role));
+        return true;
+    }
+
+    void setRolePermissions(StaffRoleId role, uint32_t permissions){
+        getRole(role).permissions.store(permissions, memory_order_release);
+    }
+
+    StaffRole& getRole(StaffRoleId role){ return roles[static_cast<int>(role)]; }
+
+    // the logged-in account, or nullptr
+    User* authenticate(string username, string password){
+        static const CallMetric logins = metrics.callMetric("account_login", "Credential checks");
+        MetricScope measured(logins);
+        User* user = find(username);
+        return user != nullptr && user->login(username, password) ? user : nullptr;
+    }
+
+    // Đăng nhập Guest hoặc Staff
+    bool login(string username, string password){
+        return authenticate(username, password) != nullptr;
+    }
+
+    void displayAllAccounts(){
+        cout << "Staff Accounts:\n";
+        int i = 1;
+        for(auto &p : staff){
+            cout << "\t#" << i++ << ". "
+                 << p.second->getUsername()
+                 << " (" << p.second->getStaffRole()->name << ")"
+                 << " [ID: " << p.second->getId() << "]"
+                 << endl;
+        }
+
+        cout << "Guest Accounts:\n";
+        i = 1;
+        for(auto &p : guests){
+            cout << "\t#" << i++ << ". " 
+                 << p.second->getUsername() 
+                 << " (" << p.second->getRole() << ")"
+                 << " [ID: " << p.second->getId() << "]"
+                 << endl;
+        }
+    }
+};
+
+class PaymentMethod : public SlabObject {
+protected:
+    string method_name;
+    double amount;
+
+public:
+    PaymentMethod(string _method_name, double _amount)
+        : method_name(_method_name), amount(_amount) {}
+
+    virtual void display(ostream& = cout) {}
+
+    string getMethodName() { return method_name; }
+    double getAmount() { return amount; }
+    virtual string getCurrency() { return "USD"; }   // card and wallet payments are charged in dollars
+    virtual uint64_t getCardToken() { return 0; }
+    virtual bool isValid() { return true; }
+    virtual void releaseCard() {}   // once the gateway has answered
+
+    virtual ~PaymentMethod() {}
+};
+
+class CashPayment : public PaymentMethod{
+private:
+    string currency;    //VND, Euro,...
+public:
+    CashPayment(double _amount, string _cur) : PaymentMethod("Cash", _amount){
+        currency = _cur;
+    }
+    string getCurrency() override {return currency;}
+    void setCurrency(string _cur){currency = _cur;}
+
+    void display(ostream& out = cout) override{
+        out << "Payment via Cash" << endl;
+        out << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
+        out << "Currency: " << getCurrency() << endl;
+        out << "====================" << endl;
+    }
+};
+
+// -------------------- Card Vault --------------------
+// Card numbers never live in payment objects. They are kept here, in one
+// page-locked region that is left out of swap and core dumps, and payments
+// only hold the token plus the BIN and last four digits. A token packs the
+// slot index with the slot's generation, so a released token stays dead even
+// after its slot is reused.
+class CardVault {
+private:
+    struct Slot {
+        uint32_t generation;
+        uint8_t length;
+        char digits[19];
+    };
+
+    Slot* slots;
+    size_t capacity;
+    size_t region_size;
+    bool locked = false;
+    vector<uint32_t> free_slots;
+    mutex vault_lock;
+
+    static void wipe(Slot& slot) {
+        volatile char* p = slot.digits;
+        for (size_t i = 0; i < sizeof(slot.digits); i++) p[i] = 0;
+        slot.length = 0;
+    }
+
+    Slot* find(uint64_t token) {
+        uint64_t index = (token & 0xffffffffu) - 1;
+        if (token == 0 || index >= capacity) return nullptr;
+        Slot& slot = slots[index];
+        if (slot.generation != (uint32_t)(token >> 32) || slot.length == 0) return nullptr;
+        return &slot;
+    }
+
+public:
+    CardVault(size_t _capacity = 4096) : capacity(_capacity) {
+        region_size = capacity * sizeof(Slot);
+        void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) throw runtime_error("card vault: cannot map memory");
+        slots = (Slot*)region;
+        locked = mlock(region, region_size) == 0;   // may fail under a low RLIMIT_MEMLOCK
+#ifdef MADV_DONTDUMP
+        madvise(region, region_size, MADV_DONTDUMP);
+#endif
+        free_slots.reserve(capacity);
+        for (size_t i = capacity; i > 0; i--) free_slots.push_back((uint32_t)(i - 1));
+    }
+
+    ~CardVault() {
+        for (size_t i = 0; i < capacity; i++) wipe(slots[i]);
+        if (locked) munlock(slots, region_size);
+        munmap(slots, region_size);
+    }
+
+    CardVault(const CardVault&) = delete;
+    CardVault& operator=(const CardVault&) = delete;
+
+    // returns 0 when the number is malformed or the vault is full
+    uint64_t tokenize(const string& pan) {
+        if (pan.size() < 12 || pan.size() > sizeof(Slot::digits)) return 0;
+        for (char c : pan) if (c < '0' || c > '9') return 0;
+
+        lock_guard<mutex> lock(vault_lock);
+        if (free_slots.empty()) return 0;
+        uint32_t index = free_slots.back();
+        free_slots.pop_back();
+        Slot& slot = slots[index];
+        memcpy(slot.digits, pan.data(), pan.size());
+        slot.length = (uint8_t)pan.size();
+        return ((uint64_t)slot.generation << 32) | (index + 1);
+    }
+
+    // writes the NUL-terminated number into out; only the gateway should need this
+    bool detokenize(uint64_t token, char* out, size_t out_size) {
+        lock_guard<mutex> lock(vault_lock);
+        Slot* slot = find(token);
+        if (slot == nullptr || out_size <= slot->length) return false;
+        memcpy(out, slot->digits, slot->length);
+        out[slot->length] = '\0';
+        return true;
+    }
+
+    void release(uint64_t token) {
+        lock_guard<mutex> lock(vault_lock);
+        Slot* slot = find(token);
+        if (slot == nullptr) return;
+        wipe(*slot);
+        slot->generation++;
+        free_slots.push_back((uint32_t)(slot - slots));
+    }
+
+    bool isLocked() { return locked; }
+    size_t size() {
+        lock_guard<mutex> lock(vault_lock);
+        return capacity - free_slots.size();
+    }
+};
+CardVault cardVault;
+
+class CreditPayment : public PaymentMethod{
+private:
+    uint64_t card_token = 0;
+    bool valid = false;   // stays true after the vault slot is released
+    char bin[6];
+    char last4[4];
+
+    void tokenize(const string& _card) {
+        card_token = cardVault.tokenize(_card);
+        valid = card_token != 0;
+        if (valid) {
+            memcpy(bin, _card.data(), sizeof(bin));
+            memcpy(last4, _card.data() + _card.size() - sizeof(last4), sizeof(last4));
+        }
+    }
+public:
+    CreditPayment(double _amount, string _card_number) : PaymentMethod("Credit", _amount){
+        tokenize(_card_number);
+    }
+    ~CreditPayment() { cardVault.release(card_token); }
+    CreditPayment(const CreditPayment&) = delete;
+    CreditPayment& operator=(const CreditPayment&) = delete;
+
+    uint64_t getCardToken() override {return card_token;}
+    // false when the number was malformed or the vault was full
+    bool isValid() override {return valid;}
+    // the number is only needed until the gateway has answered; BIN and last
+    // four digits stay for display
+    void releaseCard() override {
+        cardVault.release(card_token);
+        card_token = 0;
+    }
+    string getBin(){return isValid() ? string(bin, sizeof(bin)) : "";}
+    string getLast4(){return isValid() ? string(last4, sizeof(last4)) : "";}
+    void setCardNumber(string _card){
+        cardVault.release(card_token);
+        tokenize(_card);
+    }
+    void display(ostream& out = cout) override {
+    out << "Payment via Credit Card" << endl;
+    out << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
+    if (isValid()) {
+        out << "Card Number: ****";
+        out.write(last4, sizeof(last4)) << endl;
+    }
+    else
+        out << "Card Number: (invalid)" << endl;
+    out << "====================" << endl;
+    }
+};
+
+class eWalletPayment : public PaymentMethod{
+private:
+    string wallet_name;
+public:
+    eWalletPayment(double _amount, string _wallet_name) : PaymentMethod("e-Wallet", _amount){
+        wallet_name = _wallet_name;
+    }
+    string getWalletName(){return wallet_name;}
+    void setWalletName(string _wallet){wallet_name = _wallet;}
+    void display(ostream& out = cout) override{
+        out << "Payment via e-Wallet" << endl;
+        out << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
+        out << "Wallet Name: " << getWalletName() << endl;
+        out << "====================" << endl;
+    }
+};
+
+const size_t PAYMENT_SLOT = max({sizeof(CashPayment), sizeof(CreditPayment), sizeof(eWalletPayment)});
+Slab<PaymentMethod, PAYMENT_SLOT> paymentSlab;
+
+// -------------------- Payment Ledger --------------------
+// Append-only record of every payment, split into one-hour segments. Each
+// segment keeps running totals per (method, currency), so revenue questions
+// are answered from the totals of the segments in range without touching the
+// individual payments. Ranges are rounded out to whole local hours. Revenue
+// is what the order cost: cash handed over beyond that is kept as tendered, so
+// the drawer can account for the change.
+struct LedgerEntry {
+    SlabRef<PaymentMethod> payment;   // null for refund reversals
+    string method;
+    string currency;
+    double amount;                    // revenue; negative for refund reversals
+    time_t time;
+    string order_id;
+    double tendered = 0.0;            // cash handed over, never below amount
+};
+
+struct LedgerTotals {
+    int count = 0;             // payments
+    double amount = 0.0;       // net of refunds
+    int refund_count = 0;
+    double refunded = 0.0;
+
+    void add(double value) {
+        if (value < 0) { refund_count++; refunded -= value; }
+        else count++;
+        amount += value;
+    }
+    void add(const LedgerTotals& other) {
+        count += other.count;
+        amount += other.amount;
+        refund_count += other.refund_count;
+        refunded += other.refunded;
+    }
+};
+
+class PaymentLedger {
+private:
+    struct Segment {
+        vector<LedgerEntry> entries;
+        map<pair<string, string>, LedgerTotals> totals;   // (method, currency)
+    };
+
+    map<time_t, Segment> segments;   // keyed by bucket start
+    size_t entry_count = 0;
+    mutable mutex ledger_lock;       // payments are recorded from pipeline workers too
+
+public:
+    static const time_t BUCKET_SECONDS = 3600;
+
+    // buckets follow local hours, so local midnight (startOfToday) is always a
+    // bucket boundary, also in half-hour zones and across DST changes
+    static time_t bucketStart(time_t t) {
+        tm local;
+        localtime_r(&t, &local);
+        return t - (local.tm_min * 60 + local.tm_sec);
+    }
+
+    // due is the order total (< 0 when unknown); cash beyond it is change
+    void append(PaymentMethod* payment, time_t when, string order_id = "", double due = -1.0) {
+        if (payment == nullptr) return;
+        double amount = payment->getAmount();
+        double tendered = amount;
+        if (payment->getMethodName() == "Cash" && due >= 0.0) amount = min(amount, due);
+        append(LedgerEntry{payment, payment->getMethodName(), payment->getCurrency(), amount, when, order_id, tendered});
+    }
+
+    // entries are never edited; a refund is recorded as a negative entry
+    void appendReversal(string order_id, string method, string currency, double amount, time_t when) {
+        append(LedgerEntry{nullptr, method, currency, -amount, when, order_id});
+    }
+
+    void append(LedgerEntry entry) {
+        entry.tendered = max(entry.tendered, entry.amount);
+        time_t bucket = bucketStart(entry.time);
+        lock_guard<mutex> lock(ledger_lock);
+        Segment& seg = segments[bucket];
+        seg.totals[{entry.method, entry.currency}].add(entry.amount);
+        seg.entries.push_back(move(entry));
+        entry_count++;
+    }
+
+    // totals per currency for one method ("" = every method) over [from, to)
+    map<string, LedgerTotals> totalsByCurrency(string method, time_t from, time_t to) {
+        map<string, LedgerTotals> result;
+        lock_guard<mutex> lock(ledger_lock);
+        auto end = segments.lower_bound(to);
+        for (auto it = segments.lower_bound(bucketStart(from)); it != end; ++it) {
+            for (auto& t : it->second.totals) {
+                if (method.empty() || t.first.first == method) result[t.first.second].add(t.second);
+            }
+        }
+        return result;
+    }
+
+    LedgerTotals total(string method, string currency, time_t from, time_t to) {
+        return totalsByCurrency(method, from, to)[currency];
+    }
+
+    size_t getEntryCount() { lock_guard<mutex> lock(ledger_lock); return entry_count; }
+    size_t getSegmentCount() { lock_guard<mutex> lock(ledger_lock); return segments.size(); }
+
+    template <typename Fn>
+    void forEachEntry(Fn fn) {
+        lock_guard<mutex> lock(ledger_lock);
+        for (auto& seg : segments) {
+            for (LedgerEntry& entry : seg.second.entries) fn(entry);
+        }
+    }
+
+    // hands fn the entry lists of the segments in [from, to); appends wait until it returns
+    template <typename Fn>
+    void withSegments(time_t from, time_t to, Fn fn) {
+        vector<const vector<LedgerEntry>*> range;
+        lock_guard<mutex> lock(ledger_lock);
+        auto end = segments.lower_bound(to);
+        for (auto it = segments.lower_bound(bucketStart(from)); it != end; ++it) range.push_back(&it->second.entries);
+        fn(range);
+    }
+};
+
+time_t startOfToday() {
+    time_t now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+    local.tm_hour = 0;
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    return mktime(&local);
+}
+
+// payments are owned by paymentSlab; the manager only keeps the ledger
+class PaymentManager {
+private:
+    PaymentLedger ledger;
+public:
+    void addPayment(PaymentMethod* payment, time_t when = time(nullptr)) {
+        addPayment(payment, "", -1.0, when);
+    }
+
+    // due is the order total; a cash payment is booked at it, not at the cash handed over
+    void addPayment(PaymentMethod* payment, string order_id, double due, time_t when = time(nullptr)) {
+        static const CallMetric recorded = metrics.callMetric("payment_add", "Payments recorded in the ledger");
+        MetricScope measured(recorded);
+        if (payment != nullptr) {
+            ledger.append(payment, when, order_id, due);
+        }
+    }
+
+    void displayAllPayments(ostream& out = cout) {
+        out << "=== All Payments ===" << endl;
+        ledger.forEachEntry([&](LedgerEntry& entry) {
+            if (PaymentMethod* payment = entry.payment.get()) {
+                payment->display(out);
+            } else if (entry.amount < 0) {
+                out << "Refund for order " << entry.order_id << " via " << entry.method << endl;
+                out << "Amount: -" << fixed << setprecision(2) << -entry.amount << " " << entry.currency << endl;
+                out << "====================" << endl;
+            }
+        });
+    }
+
+    void displayRevenue(time_t from, time_t to, ostream& out = cout) {
+        out << "=== Revenue Summary ===" << endl;
+        for (string method : {"Cash", "Credit", "e-Wallet"}) {
+            for (auto& t : ledger.totalsByCurrency(method, from, to)) {
+                out << method << " (" << t.first << "): " << t.second.count << " payments, "
+                     << t.second.refund_count << " refunds, net "
+                     << fixed << setprecision(2) << t.second.amount << endl;
+            }
+        }
+        out << "=======================" << endl;
+    }
+
+    void displayTodayRevenue(ostream& out = cout) { displayRevenue(startOfToday(), time(nullptr) + 1, out); }
+
+    PaymentLedger& getLedger() { return ledger; }
+};
+PaymentManager paymentManager;
+
+// -------------------- Payment Pipeline --------------------
+// Card and wallet payments are authorized off the session thread. submit()
+// returns a future right away; worker threads drain the queue in batches and
+// several batches can be in flight at once. A batch that fails or misses the
+// timeout is retried up to max_retries times. The timeout is a deadline: the
+// gateway call runs on one of the pipeline's caller threads and the worker
+// stops waiting for it. Every request carries an idempotency key, so a retry
+// of a call that was approved late gets the same authorization back instead
+// of a second charge. Failed means the gateway's last answer was an error.
+enum class PaymentStatus { Approved, Declined, TimedOut, Failed };
+
+struct AuthRequest {
+    string order_id;
+    string method;
+    double amount;
+    string currency;
+    uint64_t card_token = 0;   // 0 unless paid by card; the gateway resolves it through cardVault
+    string idempotency_key;    // order id + payment attempt
+};
+
+struct PaymentResult {
+    PaymentStatus status = PaymentStatus::TimedOut;
+    string auth_code;
+    int attempts = 0;
+};
+
+class PaymentGateway {
+public:
+    // one result per request, in the same order; throwing means the whole batch failed
+    virtual vector<PaymentResult> authorize(const vector<AuthRequest>& batch) = 0;
+    virtual ~PaymentGateway() {}
+};
+
+// In-process stand-in for a card processor with configurable latency and an
+// optional "every Nth call fails" fault for exercising retries.
+class MockGateway : public PaymentGateway {
+private:
+    chrono::microseconds latency;
+    int fail_every;
+    atomic<long> calls{0};
+    atomic<long> approved{0};
+    mutex approvals_lock;
+    unordered_map<string, string> approvals;   // idempotency key -> auth code
+
+    // a key seen before gets its original authorization back
+    string approve(const string& key) {
+        if (key.empty()) return "A" + to_string(++approved);
+        lock_guard<mutex> lock(approvals_lock);
+        auto it = approvals.find(key);
+        if (it != approvals.end()) return it->second;
+        return approvals[key] = "A" + to_string(++approved);
+    }
+
+public:
+    MockGateway(chrono::microseconds _latency = chrono::microseconds(2000), int _fail_every = 0)
+        : latency(_latency), fail_every(_fail_every) {}
+
+    vector<PaymentResult> authorize(const vector<AuthRequest>& batch) override {
+        long call = ++calls;
+        this_thread::sleep_for(latency);
+        if (fail_every > 0 && call % fail_every == 0) throw runtime_error("gateway unavailable");
+
+        vector<PaymentResult> results(batch.size());
+        for (size_t i = 0; i < batch.size(); i++) {
+            char pan[20];
+            bool card_ok = batch[i].method != "Credit" || cardVault.detokenize(batch[i].card_token, pan, sizeof(pan));
+            if (batch[i].amount <= 0.0 || !card_ok) {
+                results[i].status = PaymentStatus::Declined;
+            } else {
+                results[i].status = PaymentStatus::Approved;
+                results[i].auth_code = approve(batch[i].idempotency_key);
+            }
+        }
+        return results;
+    }
+
+    long getCallCount() { return calls.load(); }
+    long getApprovedCount() { return approved.load(); }
+};
+
+class PaymentPipeline {
+private:
+    struct Pending {
+        AuthRequest request;
+        promise<PaymentResult> done;
+        function<void(const PaymentResult&)> callback;
+        int attempts = 0;
+    };
+
+    // the gateway's error is passed as text, so no exception object is shared
+    // between the caller and the worker
+    struct GatewayCall {
+        vector<AuthRequest> requests;
+        promise<vector<PaymentResult>> results;
+        future<vector<PaymentResult>> answer;
+        string error;   // set before results when the gateway threw
+    };
+
+    PaymentGateway& gateway;
+    size_t max_batch;
+    chrono::milliseconds timeout;
+    int max_retries;
+    int worker_count;
+
+    mutex queue_lock;
+    condition_variable queue_ready;
+    deque<Pending*> queue;
+    vector<thread> workers;
+    bool stopping = false;
+
+    // a fixed pool runs the gateway calls, so a slow gateway costs no thread creation;
+    // there are twice as many callers as workers, so one abandoned call per
+    // worker does not hold up the next
+    mutex calls_lock;
+    condition_variable calls_ready;
+    condition_variable calls_done;
+    deque<shared_ptr<GatewayCall>> calls;
+    vector<thread> callers;
+    bool callers_stopping = false;
+    int calls_in_flight = 0;   // queued or running
+
+    void finish(Pending* p, PaymentResult result) {
+        result.attempts = p->attempts;
+        if (p->callback) {
+            try {
+                p->callback(result);
+            } catch (const exception& e) {
+                LOG_ERROR("payment callback for order {} failed: {}", p->request.order_id, e.what());
+            }
+        }
+        p->done.set_value(result);
+        delete p;
+    }
+
+    // a call that misses its deadline keeps running on its caller and its result is dropped
+    shared_ptr<GatewayCall> startCall(const vector<AuthRequest>& requests) {
+        shared_ptr<GatewayCall> call = make_shared<GatewayCall>();
+        call->requests = requests;
+        call->answer = call->results.get_future();
+        {
+            lock_guard<mutex> lock(calls_lock);
+            calls_in_flight++;
+            calls.push_back(call);
+        }
+        calls_ready.notify_one();
+        return call;
+    }
+
+    void callerLoop() {
+        while (true) {
+            shared_ptr<GatewayCall> call;
+            {
+                unique_lock<mutex> lock(calls_lock);
+                calls_ready.wait(lock, [&] { return callers_stopping || !calls.empty(); });
+                if (calls.empty()) return;   // stopping and drained
+                call = calls.front();
+                calls.pop_front();
+            }
+            vector<PaymentResult> results;
+            try {
+                results = gateway.authorize(call->requests);
+            } catch (const exception& e) {
+                call->error = e.what();
+            } catch (...) {
+                call->error = "unknown error";
+            }
+            call->results.set_value(move(results));
+            lock_guard<mutex> lock(calls_lock);
+            if (--calls_in_flight == 0) calls_done.notify_all();
+        }
+    }
+
+    void workerLoop() {
+        vector<Pending*> batch;
+        vector<AuthRequest> requests;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queue_lock);
+                queue_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;   // stopping and drained
+                while (!queue.empty() && batch.size() < max_batch) {
+                    batch.push_back(queue.front());
+                    queue.pop_front();
+                }
+            }
+
+            requests.clear();
+            for (Pending* p : batch) {
+                p->attempts++;
+                requests.push_back(p->request);
+            }
+
+            vector<PaymentResult> results;
+            shared_ptr<GatewayCall> call = startCall(requests);
+            PaymentResult failure;   // what the batch gets once its retries are used up
+            bool ok = call->answer.wait_for(timeout) == future_status::ready;
+            if (ok) {
+                results = call->answer.get();
+                if (!call->error.empty()) {
+                    LOG_WARN("gateway call for {} payments failed: {}", batch.size(), call->error);
+                    failure.status = PaymentStatus::Failed;
+                    ok = false;
+                }
+            }
+            if (ok && results.size() != batch.size()) {
+                LOG_WARN("gateway answered {} of {} payments", results.size(), batch.size());
+                failure.status = PaymentStatus::Failed;
+                ok = false;
+            }
+
+            vector<Pending*> retry;
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (ok) finish(batch[i], results[i]);
+                else if (batch[i]->attempts > max_retries) finish(batch[i], failure);
+                else retry.push_back(batch[i]);
+            }
+            batch.clear();
+
+            if (!retry.empty()) {
+                lock_guard<mutex> lock(queue_lock);
+                for (Pending* p : retry) queue.push_front(p);
+                queue_ready.notify_one();
+            }
+        }
+    }
+
+    void startWorkers() {
+        if (!workers.empty()) return;
+        for (int i = 0; i < worker_count; i++) workers.emplace_back(&PaymentPipeline::workerLoop, this);
+        lock_guard<mutex> lock(calls_lock);
+        if (callers.empty()) {
+            for (int i = 0; i < 2 * worker_count; i++) callers.emplace_back(&PaymentPipeline::callerLoop, this);
+        }
+    }
+
+public:
+    PaymentPipeline(PaymentGateway& _gateway, size_t _max_batch = 64, chrono::milliseconds _timeout = chrono::milliseconds(500),
+                    int _max_retries = 2, int _worker_count = 4)
+        : gateway(_gateway), max_batch(_max_batch), timeout(_timeout), max_retries(_max_retries), worker_count(_worker_count) {}
+
+    // abandoned gateway calls finish before their callers are joined
+    ~PaymentPipeline() {
+        shutdown();
+        {
+            lock_guard<mutex> lock(calls_lock);
+            callers_stopping = true;
+        }
+        calls_ready.notify_all();
+        for (thread& t : callers) t.join();
+    }
+
+    future<PaymentResult> submit(AuthRequest request, function<void(const PaymentResult&)> callback = nullptr) {
+        Pending* p = new Pending();
+        p->request = request;
+        p->callback = callback;
+        future<PaymentResult> result = p->done.get_future();
+        {
+            lock_guard<mutex> lock(queue_lock);
+            startWorkers();
+            queue.push_back(p);
+        }
+        queue_ready.notify_one();
+        return result;
+    }
+
+    // finishes everything already submitted, then stops the workers
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(queue_lock);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        for (thread& t : workers) t.join();
+        workers.clear();
+        stopping = false;
+    }
+
+    // waits for gateway calls that were abandoned after their deadline
+    void waitForGateway() {
+        unique_lock<mutex> lock(calls_lock);
+        calls_done.wait(lock, [&] { return calls_in_flight == 0; });
+    }
+};
+MockGateway mockGateway;
+PaymentPipeline paymentPipeline(mockGateway);
+
+// -------------------- Payment Idempotency --------------------
+// Remembers the result of every payment submission by key (order id + attempt)
+// for a limited time, so a repeated submit gets the original result back
+// instead of charging again. Entries expire in insertion order, which with a
+// fixed TTL is also expiry order, so eviction is a pop from the front.
+class IdempotencyIndex {
+private:
+    struct Entry {
+        shared_future<PaymentResult> result;
+        chrono::steady_clock::time_point expires;
+    };
+
+    unordered_map<string, Entry> index;
+    deque<pair<string, chrono::steady_clock::time_point>> order;   // (key, expires)
+    size_t capacity;
+    chrono::steady_clock::duration ttl;
+    mutex index_lock;
+
+    void evict(chrono::steady_clock::time_point now) {
+        while (!order.empty() && (order.front().second <= now || index.size() > capacity)) {
+            auto it = index.find(order.front().first);
+            // a key re-added after expiring has a newer deadline; keep it
+            if (it != index.end() && it->second.expires == order.front().second) index.erase(it);
+            order.pop_front();
+        }
+    }
+
+public:
+    IdempotencyIndex(size_t _capacity, chrono::steady_clock::duration _ttl) : capacity(_capacity), ttl(_ttl) {
+        index.reserve(_capacity);
+    }
+
+    // Returns the stored result for key, or runs submit() and stores its result.
+    // duplicate tells the caller which of the two happened.
+    shared_future<PaymentResult> findOrAdd(const string& key, function<shared_future<PaymentResult>()> submit, bool& duplicate) {
+        lock_guard<mutex> lock(index_lock);
+        auto now = chrono::steady_clock::now();
+        evict(now);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            duplicate = true;
+            return it->second.result;
+        }
+        duplicate = false;
+        Entry entry{submit(), now + ttl};
+        index[key] = entry;
+        order.push_back({key, entry.expires});
+        evict(now);
+        return entry.result;
+    }
+
+    // drops a key whose result is not final, so the next submit runs again
+    void forget(const string& key) {
+        lock_guard<mutex> lock(index_lock);
+        index.erase(key);
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(index_lock);
+        evict(chrono::steady_clock::now());
+        return index.size();
+    }
+};
+IdempotencyIndex paymentIdempotency(100000, chrono::minutes(30));
+
+enum class OrderStatus { Pending, Preparing, Completed, Cancelled };
+// -------------------- Reservation --------------------
+class Reservation : public SlabObject {
+    private:
+    string reservation_id;
+    User* customer;
+    string date;
+    string time;
+    int party_size;
+    string status;
+    NotificationManager* notifier;
+    inline static atomic<int> reservation_cnt{0};
+public:
+    Reservation(User* _customer, string _date, string _time, int _party_size, NotificationManager& _notifier = notificationManager)
+        : customer(_customer), date(_date), time(_time), party_size(_party_size), status("Pending"), notifier(&_notifier) {
+        int number = ++reservation_cnt;
+        stringstream ss;
+        ss << "R" << setw(3) << setfill('0') << number;
+        reservation_id = ss.str();
+        notifier->sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Confirmed", "Reservation " + reservation_id + " for " + to_string(party_size) + " people on " + date + " at " + _time + " is pending confirmation.");
+    }
+    void setStatus(string s){
+        status = s;
+        if (s == "Confirmed") {
+            notifier->sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Confirmed", "Reservation " + reservation_id + " is confirmed.");
+        } else if (s == "Cancelled") {
+            notifier->sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Cancelled", "Reservation " + reservation_id + " is cancelled.");
+        }
+    }
+    string getReservationID(){
+        return reservation_id;
+    }
+    string getStatus(){
+        return status;
+    }
+    string getDate(){
+        return date;
+    }
+    string getTime(){
+        return time;
+    }
+    User* getCustomer(){
+        return customer;
+    }
+    void displayInfo(ostream& out = cout){
+        out << "=== Reservation Details ===" << endl;
+        out << "Reservation ID: " << reservation_id << endl;
+        if (customer) {
+            out<< "Customer: " << customer->getUsername() << " ( ID: " << customer->getId() << " )" << endl;
+        }
+        out<<"Date: "<<date<<endl;
+        out<<"Time: "<<time<<endl;
+        out<<"Party Size: "<<party_size<<endl;
+        out<<"Status: "<<status<<endl;
+        out<< "==========================" <<endl;
+    }
+};
+Slab<Reservation> reservationSlab;
+// -------------------- Order --------------------
+class Order;
+void onOrderCancelled(Order& order);   // defined with the refund engine
+void onOrderCompleted(Order& order);   // defined with the demand forecaster
+
+// one food or combo on an order: the id never changes while the order lives
+// and the price is the one charged when the line was added
+struct OrderLine {
+    int id = 0;
+    double price = 0.0;
+};
+
+class Order : public SlabObject {
+private:
+    string order_id;
+    User* customer;
+    vector<FoodRef> food_items;
+    vector<OrderLine> food_lines;    // parallel to food_items
+    vector<Combo> combos;
+    vector<OrderLine> combo_lines;   // parallel to combos
+    int line_cnt = 0;
+    double total_price;
+    OrderStatus status;
+    time_t created_at;
+    SlabRef<PaymentMethod> payment;
+    bool paid = false;
+    vector<const Recipe*> reserved_stock;   // one per food reserved for this order
+    int payment_attempt = 1;   // part of the idempotency key; bumped after a failed payment
+    NotificationManager* notifier;
+    inline static atomic<int> order_cnt{0};
+
+    void calculateTotal() {
+        double total = 0.0;
+        for (OrderLine& line : food_lines) {
+            total += line.price;
+        }
+        for (OrderLine& line : combo_lines) {
+            total += line.price;
+        }
+        total_price = total;
+    }
+
+public:
+    Order(User* _customer, NotificationManager& _notifier = notificationManager) : customer(_customer), notifier(&_notifier) {
+        int number = ++order_cnt;
+        stringstream ss;
+        ss << "O" << setw(3) << setfill('0') << number;
+        order_id = ss.str();
+        total_price = 0.0;
+        created_at = time(nullptr);
+        status = OrderStatus::Pending; // mặc định
+        notifier->sendOrderUpdate(order_id, "Confirmed"); //confirmation notification
+    }
+
+    // Completed and Cancelled are final: later changes are refused, so a
+    // completed order is never cancelled (and its stock never released)
+    bool setStatus(OrderStatus s) { //updated status based on status change
+         if (status == OrderStatus::Completed || status == OrderStatus::Cancelled) return false;
+         if (s == status) return true;
+         status = s;
+         switch(s) { 
+            case OrderStatus::Preparing:
+                notifier->sendOrderUpdate(order_id, "Preparing");
+                break;
+            case OrderStatus::Completed:
+                notifier->sendOrderUpdate(order_id, "Ready");
+                onOrderCompleted(*this);
+                break;
+            case OrderStatus::Cancelled:
+                releaseStock();
+                onOrderCancelled(*this);
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+    void setPaymentMethod(PaymentMethod* pm){payment = pm;}
+
+    // called once the payment has been authorized and recorded
+    void markPaid(PaymentMethod* pm) {
+        payment = pm;
+        paid = true;
+    }
+    bool isPaid() { return paid; }
+    int getPaymentAttempt() { return payment_attempt; }
+    void nextPaymentAttempt() { payment_attempt++; }
+    double getTotalPrice() { return total_price; }
+    OrderStatus getStatus() { return status; }
+    time_t getCreatedAt() { return created_at; }
+    string getOrderId() { return order_id; }
+    User* getCustomer() { return customer; }
+    PaymentMethod* getPaymentMethod() { return payment.get(); }
+
+    vector<Combo> getCombos() { return combos; }
+    // every line in display order, including foods freed since ordering
+    vector<OrderLine> getFoodLines() { return food_lines; }
+    vector<OrderLine> getComboLines() { return combo_lines; }
+    size_t getLineCount() { return food_lines.size() + combo_lines.size(); }
+
+    // removed menu foods stay in the order; only foods freed by their owner
+    // after ordering are skipped
+    vector<Food*> getFoodItems() {
+        vector<Food*> items;
+        for (auto& ref : food_items) {
+            if (Food* food = ref.get()) items.push_back(food);
+        }
+        return items;
+    }
+
+    // adds quantity lines of the food, or none when the kitchen runs out of
+    // an ingredient partway
+    bool addFood(Food* food, int quantity = 1) {
+        static const CallMetric adds = metrics.callMetric("order_add_food", "Foods added to orders");
+        MetricScope measured(adds);
+        if (food == nullptr || quantity < 1) return false;
+        size_t reserved_before = reserved_stock.size();
+        for (int i = 0; i < quantity; i++) {
+            const Recipe* recipe = inventory.reserve(food);
+            if (recipe == nullptr) {
+                releaseStock(reserved_before);
+                return false;
+            }
+            reserved_stock.push_back(recipe);
+        }
+        for (int i = 0; i < quantity; i++) {
+            food_items.push_back(food);
+            food_lines.push_back({++line_cnt, food->getPrice()});
+        }
+        calculateTotal();
+        return true;
+    }
+
+    bool addCombo(Combo combo) {
+        size_t reserved_before = reserved_stock.size();
+        for (Food* food : combo.getFoodItems()) {
+            const Recipe* recipe = inventory.reserve(food);
+            if (recipe == nullptr) {
+                releaseStock(reserved_before);
+                return false;
+            }
+            reserved_stock.push_back(recipe);
+        }
+        combos.push_back(combo);
+        combo_lines.push_back({++line_cnt, combo.getPrice()});
+        calculateTotal();
+        return true;
+    }
+
+    // gives back the stock reserved after the first keep lines
+    void releaseStock(size_t keep = 0) {
+        for (size_t i = keep; i < reserved_stock.size(); i++) inventory.release(reserved_stock[i]);
+        reserved_stock.resize(min(keep, reserved_stock.size()));
+    }
+
+    // Replaces separately ordered foods with the cheapest set of matching combos.
+    // Returns the number of combos applied.
+    int applyBestCombos(vector<Combo*> available) {
+        vector<Food*> lines;
+        vector<size_t> positions;   // index in food_items of each matcher line
+        for (size_t i = 0; i < food_items.size(); i++) {
+            if (Food* food = food_items[i].get()) {
+                lines.push_back(food);
+                positions.push_back(i);
+            }
+        }
+        ComboMatcher matcher;
+        vector<ComboMatch> matches = matcher.findCheapest(lines, available);
+        if (matches.empty()) return 0;
+
+        vector<bool> covered(food_items.size(), false);
+        for (ComboMatch& match : matches) {
+            for (int line : match.lines) covered[positions[line]] = true;
+            combos.push_back(*match.combo);
+            combo_lines.push_back({++line_cnt, match.combo->getPrice()});
+        }
+        vector<FoodRef> remaining;
+        vector<OrderLine> remaining_lines;
+        for (size_t i = 0; i < food_items.size(); i++) {
+            if (!covered[i]) {
+                remaining.push_back(food_items[i]);
+                remaining_lines.push_back(food_lines[i]);
+            }
+        }
+        food_items = remaining;
+        food_lines = remaining_lines;
+        calculateTotal();
+        return (int)matches.size();
+    }
+
+    void display(ostream& out = cout) {
+        out << "=== Order Details ===" << endl;
+        out << "Order ID: " << order_id << endl;
+        if (customer) {
+            out << "Customer: " << customer->getUsername() 
+                 << " (" << customer->getId() << ")" << endl;
+        }
+        out << "Status: ";
+        switch (status) {
+            case OrderStatus::Pending: out << "Pending"; break;
+            case OrderStatus::Preparing: out << "Preparing"; break;
+            case OrderStatus::Completed: out << "Completed"; break;
+            case OrderStatus::Cancelled: out << "Cancelled"; break;
+        }
+        out << endl;
+
+        out << "Items in order:" << endl;
+        for (auto& ref : food_items) {
+            out << "  - ";
+            if (Food* food = ref.get()) food->display(out);
+            else out << "(item no longer on the menu)" << endl;
+        }
+        for (Combo& combo : combos) {
+            out << "  - Combo: " << combo.getComboName() << endl;
+            combo.display(out);
+        }
+        out << "Total Price: $" << fixed << setprecision(2) << total_price << endl;
+
+        if(payment.get()){
+            out << "Payment Details: " << (paid ? "(Paid)" : "(Authorizing)") << endl;
+            payment.get()->display(out);
+        } else {
+            out << "Payment Method: Not set" << endl;
+        }
+        out << "=====================" << endl;
+    }
+};
+Slab<Order> orderSlab;
+
+// -------------------- Refunds --------------------
+// Refunds are requested on the session thread and written to the ledger as
+// reversal entries by a background worker, a batch at a time. Each order's
+// refunds are kept under its id, and refunded line ids are remembered so the
+// same line is never paid back twice. A line is refunded at the price it was
+// charged, whatever the menu says now.
+enum class RefundStatus { Pending, Processed };
+
+struct RefundRecord {
+    string refund_id;
+    string order_id;
+    string method;
+    string currency;
+    double amount = 0.0;
+    vector<int> lines;    // order line ids
+    RefundStatus status = RefundStatus::Pending;
+};
+
+class RefundEngine {
+private:
+    struct OrderRefunds {
+        vector<RefundRecord> records;
+        set<int> refunded_lines;   // order line ids
+        double refunded = 0.0;
+    };
+
+    unordered_map<string, OrderRefunds> by_order;
+    deque<pair<string, size_t>> queue;   // (order id, record index)
+    size_t batch_size;
+    int refund_cnt = 0;
+    size_t in_progress = 0;
+    bool stopping = false;
+    mutex refund_lock;
+    condition_variable work_ready;
+    condition_variable all_done;
+    thread worker;
+
+    void workerLoop() {
+        vector<pair<string, size_t>> batch;
+        vector<RefundRecord> records;
+        while (true) {
+            {
+                unique_lock<mutex> lock(refund_lock);
+                work_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                while (!queue.empty() && batch.size() < batch_size) {
+                    batch.push_back(queue.front());
+                    records.push_back(by_order[queue.front().first].records[queue.front().second]);
+                    queue.pop_front();
+                }
+                in_progress = batch.size();
+            }
+
+            time_t now = time(nullptr);
+            for (RefundRecord& r : records) {
+                paymentManager.getLedger().appendReversal(r.order_id, r.method, r.currency, r.amount, now);
+            }
+
+            {
+                lock_guard<mutex> lock(refund_lock);
+                for (auto& item : batch) by_order[item.first].records[item.second].status = RefundStatus::Processed;
+                in_progress = 0;
+            }
+            all_done.notify_all();
+            batch.clear();
+            records.clear();
+        }
+    }
+
+    // Already refunded lines are skipped. Lines are marked refunded only together
+    // with the record that pays them back, so every marked line is in a record.
+    string createRefund(Order& order, const vector<OrderLine>& lines) {
+        PaymentMethod* payment = order.getPaymentMethod();
+        if (!order.isPaid() || payment == nullptr) return "";
+
+        lock_guard<mutex> lock(refund_lock);
+        auto it = by_order.find(order.getOrderId());
+        RefundRecord record;
+        for (const OrderLine& line : lines) {
+            bool done = it != by_order.end() && it->second.refunded_lines.count(line.id) > 0;
+            if (done || find(record.lines.begin(), record.lines.end(), line.id) != record.lines.end()) continue;
+            record.lines.push_back(line.id);
+            record.amount += line.price;
+        }
+        // never pay back more than the order was charged
+        double refunded = it != by_order.end() ? it->second.refunded : 0.0;
+        record.amount = min(record.amount, order.getTotalPrice() - refunded);
+        if (record.lines.empty() || record.amount <= 0.0) return "";
+
+        OrderRefunds& refunds = by_order[order.getOrderId()];
+        refunds.refunded_lines.insert(record.lines.begin(), record.lines.end());
+        stringstream ss;
+        ss << "RF" << setw(3) << setfill('0') << ++refund_cnt;
+        record.refund_id = ss.str();
+        record.order_id = order.getOrderId();
+        record.method = payment->getMethodName();
+        record.currency = payment->getCurrency();
+        refunds.refunded += record.amount;
+        refunds.records.push_back(record);
+        queue.push_back({record.order_id, refunds.records.size() - 1});
+
+        if (!worker.joinable()) worker = thread(&RefundEngine::workerLoop, this);
+        work_ready.notify_one();
+        return record.refund_id;
+    }
+
+public:
+    RefundEngine(size_t _batch_size = 64) : batch_size(_batch_size) {}
+
+    ~RefundEngine() {
+        {
+            lock_guard<mutex> lock(refund_lock);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // refunds every line that has not been refunded yet
+    string refundOrder(Order& order) {
+        vector<OrderLine> lines = order.getFoodLines();
+        vector<OrderLine> combos = order.getComboLines();
+        lines.insert(lines.end(), combos.begin(), combos.end());
+        return createRefund(order, lines);
+    }
+
+    // positions as shown on the order, starting at 0
+    string refundLines(Order& order, vector<int> food_lines, vector<int> combo_lines) {
+        vector<OrderLine> lines;
+        vector<OrderLine> foods = order.getFoodLines();
+        vector<OrderLine> combos = order.getComboLines();
+        for (int i : food_lines) {
+            if (i >= 0 && i < (int)foods.size()) lines.push_back(foods[i]);
+        }
+        for (int i : combo_lines) {
+            if (i >= 0 && i < (int)combos.size()) lines.push_back(combos[i]);
+        }
+        return createRefund(order, lines);
+    }
+
+    vector<RefundRecord> findByOrder(string order_id) {
+        lock_guard<mutex> lock(refund_lock);
+        auto it = by_order.find(order_id);
+        return it != by_order.end() ? it->second.records : vector<RefundRecord>();
+    }
+
+    bool isLineRefunded(string order_id, int line_id) {
+        lock_guard<mutex> lock(refund_lock);
+        auto it = by_order.find(order_id);
+        return it != by_order.end() && it->second.refunded_lines.count(line_id) > 0;
+    }
+
+    double getRefundedAmount(string order_id) {
+        lock_guard<mutex> lock(refund_lock);
+        auto it = by_order.find(order_id);
+        return it != by_order.end() ? it->second.refunded : 0.0;
+    }
+
+    void waitUntilProcessed() {
+        unique_lock<mutex> lock(refund_lock);
+        all_done.wait(lock, [&] { return queue.empty() && in_progress == 0; });
+    }
+};
+RefundEngine refundEngine;
+
+void onOrderCancelled(Order& order) {
+    string refund_id = refundEngine.refundOrder(order);
+    if (refund_id.empty()) return;
+    vector<RefundRecord> records = refundEngine.findByOrder(order.getOrderId());
+    LOG_INFO("order {} cancelled, refunding {} ({})", order.getOrderId(), records.back().amount, refund_id);
+}
+
+// -------------------- Settlement --------------------
+// End-of-day reconciliation of orders against the ledger. Ledger entries and
+// orders are both split into partitions by a hash of the order id, so each
+// partition is matched by a single worker without locks, and the workers'
+// reports are merged at the end. Cash entries carry the tendered amount next to
+// the revenue, so the drawer totals include the change handed back. Amounts are
+// kept per currency; an order paid in several currencies cannot be checked
+// against its total without exchange rates, so it is flagged for a manual check.
+enum class SettlementIssueKind { Unpaid, Underpaid, Overpaid, NotRefunded, OrphanPayment, MixedCurrency };
+const int SETTLEMENT_ISSUE_KINDS = 6;
+
+string issueKindName(SettlementIssueKind kind) {
+    switch (kind) {
+        case SettlementIssueKind::Unpaid: return "Unpaid";
+        case SettlementIssueKind::Underpaid: return "Underpaid";
+        case SettlementIssueKind::Overpaid: return "Overpaid";
+        case SettlementIssueKind::NotRefunded: return "Not refunded";
+        case SettlementIssueKind::OrphanPayment: return "Orphan payment";
+        case SettlementIssueKind::MixedCurrency: return "Mixed currencies";
+    }
+    return "";
+}
+
+struct SettlementIssue {
+    string order_id;
+    SettlementIssueKind kind;
+    double expected;
+    double received;
+    string currency;   // of received; empty when it spans currencies
+};
+
+struct CashDrawer {
+    double tendered = 0.0;
+    double change = 0.0;
+    double refunded = 0.0;
+    double expected() const { return tendered - change - refunded; }
+};
+
+struct SettlementReport {
+    size_t orders = 0;
+    size_t settled = 0;
+    size_t payments = 0;
+    double sales = 0.0;                // price of the orders that were not cancelled
+    map<string, double> collected;     // per currency, kept after change and refunds
+    size_t issue_counts[SETTLEMENT_ISSUE_KINDS] = {};
+    vector<SettlementIssue> issues;
+    map<string, CashDrawer> drawers;   // cash only, per currency
+    double seconds = 0.0;
+
+    void addIssue(string order_id, SettlementIssueKind kind, double expected, double received, string currency = "") {
+        issue_counts[(int)kind]++;
+        issues.push_back({order_id, kind, expected, received, currency});
+    }
+
+    size_t countOf(SettlementIssueKind kind) { return issue_counts[(int)kind]; }
+
+    void merge(SettlementReport& other) {
+        orders += other.orders;
+        settled += other.settled;
+        payments += other.payments;
+        sales += other.sales;
+        for (auto& c : other.collected) collected[c.first] += c.second;
+        for (int i = 0; i < SETTLEMENT_ISSUE_KINDS; i++) issue_counts[i] += other.issue_counts[i];
+        issues.insert(issues.end(), other.issues.begin(), other.issues.end());
+        for (auto& d : other.drawers) {
+            CashDrawer& drawer = drawers[d.first];
+            drawer.tendered += d.second.tendered;
+            drawer.change += d.second.change;
+            drawer.refunded += d.second.refunded;
+        }
+    }
+
+    void display(size_t max_issues = 10, ostream& out = cout) {
+        out << "=== Settlement Report ===" << endl;
+        out << "Orders: " << orders << " (" << settled << " settled), payments: " << payments << endl;
+        out << fixed << setprecision(2) << "Sales: $" << sales << ", collected:";
+        for (auto& c : collected) out << " " << c.second << " " << c.first;
+        out << endl;
+        for (int i = 0; i < SETTLEMENT_ISSUE_KINDS; i++) {
+            if (issue_counts[i] > 0) out << issueKindName((SettlementIssueKind)i) << ": " << issue_counts[i] << endl;
+        }
+        for (auto& d : drawers) {
+            out << "Cash drawer (" << d.first << "): tendered " << d.second.tendered << ", change " << d.second.change
+                 << ", refunded " << d.second.refunded << ", expected " << d.second.expected() << endl;
+        }
+        for (size_t i = 0; i < issues.size() && i < max_issues; i++) {
+            SettlementIssue& issue = issues[i];
+            out << "  " << (issue.order_id.empty() ? "(no order)" : issue.order_id) << " " << issueKindName(issue.kind)
+                 << ": expected " << issue.expected << ", received " << issue.received;
+            if (!issue.currency.empty()) out << " " << issue.currency;
+            out << endl;
+        }
+        if (issues.size() > max_issues) out << "  ... " << issues.size() - max_issues << " more" << endl;
+        out << "Settled in " << setprecision(1) << seconds * 1000 << " ms" << endl;
+        out << "=========================" << endl;
+    }
+};
+
+// runs fn(0) .. fn(workers - 1) on their own threads, fn(0) on the caller's
+template <typename Fn>
+void runWorkers(unsigned workers, Fn fn) {
+    vector<thread> threads;
+    for (unsigned w = 1; w < workers; w++) threads.emplace_back(fn, w);
+    fn(0);
+    for (thread& t : threads) t.join();
+}
+
+class SettlementEngine {
+private:
+    // one order's entries in one currency
+    struct CurrencyTotals {
+        double paid = 0.0;
+        double refunded = 0.0;
+        bool cash = false;
+        double cash_paid = 0.0;       // the cash part, which alone feeds the drawer
+        double cash_tendered = 0.0;
+        double cash_refunded = 0.0;
+    };
+    struct Received {
+        map<string, CurrencyTotals> currencies;
+        int payments = 0;
+        bool matched = false;
+    };
+    typedef unordered_map<string, Received> Partition;
+
+    static const size_t CHUNK = 16384;
+    static constexpr double EPSILON = 0.005;
+    unsigned workers;
+
+    size_t partitionOf(const string& order_id) { return hash<string>()(order_id) % workers; }
+
+    static void settleOrder(Order* order, Received* received, SettlementReport& report) {
+        report.orders++;
+        bool cancelled = order->getStatus() == OrderStatus::Cancelled;
+        double due = cancelled ? 0.0 : order->getTotalPrice();
+        if (!cancelled) report.sales += due;
+        if (received == nullptr) {
+            if (due > EPSILON) report.addIssue(order->getOrderId(), SettlementIssueKind::Unpaid, due, 0.0);
+            else report.settled++;
+            return;
+        }
+
+        received->matched = true;
+        bool refunded = true;
+        for (auto& c : received->currencies) {
+            CurrencyTotals& t = c.second;
+            if (t.cash) {
+                CashDrawer& drawer = report.drawers[c.first];
+                drawer.tendered += t.cash_tendered;
+                drawer.change += t.cash_tendered - t.cash_paid;
+                drawer.refunded += t.cash_refunded;
+            }
+            double kept = t.paid - t.refunded;
+            report.collected[c.first] += kept;
+            if (cancelled && kept > EPSILON) {
+                report.addIssue(order->getOrderId(), SettlementIssueKind::NotRefunded, 0.0, kept, c.first);
+                refunded = false;
+            }
+        }
+        if (cancelled) {
+            if (refunded) report.settled++;
+            return;
+        }
+        if (received->currencies.size() > 1) {
+            report.addIssue(order->getOrderId(), SettlementIssueKind::MixedCurrency, due, 0.0);
+            return;
+        }
+
+        const string& currency = received->currencies.begin()->first;
+        double charged = received->currencies.begin()->second.paid;
+        if (charged < due - EPSILON) report.addIssue(order->getOrderId(), SettlementIssueKind::Underpaid, due, charged, currency);
+        else if (charged > due + EPSILON) report.addIssue(order->getOrderId(), SettlementIssueKind::Overpaid, due, charged, currency);
+        else report.settled++;
+    }
+
+public:
+    SettlementEngine(unsigned _workers = 0) : workers(_workers ? _workers : max(1u, thread::hardware_concurrency())) {}
+
+    SettlementReport settle(vector<Order*>& orders, PaymentLedger& ledger, time_t from, time_t to) {
+        auto start = chrono::steady_clock::now();
+        vector<Partition> partitions(workers);
+
+        ledger.withSegments(from, to, [&](const vector<const vector<LedgerEntry>*>& segments) {
+            vector<pair<const vector<LedgerEntry>*, size_t>> chunks;
+            for (const vector<LedgerEntry>* seg : segments) {
+                for (size_t i = 0; i < seg->size(); i += CHUNK) chunks.push_back({seg, i});
+            }
+            vector<vector<vector<const LedgerEntry*>>> buckets(workers, vector<vector<const LedgerEntry*>>(workers));
+            atomic<size_t> next{0};
+            runWorkers(workers, [&](unsigned w) {
+                for (size_t c; (c = next++) < chunks.size();) {
+                    const vector<LedgerEntry>& seg = *chunks[c].first;
+                    size_t end = min(seg.size(), chunks[c].second + CHUNK);
+                    for (size_t i = chunks[c].second; i < end; i++) buckets[w][partitionOf(seg[i].order_id)].push_back(&seg[i]);
+                }
+            });
+            runWorkers(workers, [&](unsigned p) {
+                for (unsigned w = 0; w < workers; w++) {
+                    for (const LedgerEntry* entry : buckets[w][p]) {
+                        Received& r = partitions[p][entry->order_id];
+                        CurrencyTotals& t = r.currencies[entry->currency];
+                        bool cash = entry->method == "Cash";
+                        t.cash = t.cash || cash;
+                        if (entry->amount < 0) {
+                            t.refunded -= entry->amount;
+                            if (cash) t.cash_refunded -= entry->amount;
+                        } else {
+                            t.paid += entry->amount;
+                            r.payments++;
+                            if (cash) {
+                                t.cash_paid += entry->amount;
+                                t.cash_tendered += entry->tendered;
+                            }
+                        }
+                    }
+                }
+            });
+        });
+
+        vector<vector<vector<Order*>>> order_buckets(workers, vector<vector<Order*>>(workers));
+        atomic<size_t> next{0};
+        runWorkers(workers, [&](unsigned w) {
+            for (size_t begin; (begin = next.fetch_add(CHUNK)) < orders.size();) {
+                size_t end = min(orders.size(), begin + CHUNK);
+                for (size_t i = begin; i < end; i++) order_buckets[w][partitionOf(orders[i]->getOrderId())].push_back(orders[i]);
+            }
+        });
+
+        vector<SettlementReport> reports(workers);
+        runWorkers(workers, [&](unsigned p) {
+            Partition& partition = partitions[p];
+            SettlementReport& report = reports[p];
+            for (unsigned w = 0; w < workers; w++) {
+                for (Order* order : order_buckets[w][p]) {
+                    auto it = partition.find(order->getOrderId());
+                    settleOrder(order, it != partition.end() ? &it->second : nullptr, report);
+                }
+            }
+            for (auto& r : partition) {
+                report.payments += r.second.payments;
+                if (r.second.matched) continue;
+                for (auto& c : r.second.currencies) {
+                    report.addIssue(r.first, SettlementIssueKind::OrphanPayment, 0.0, c.second.paid - c.second.refunded, c.first);
+                }
+            }
+        });
+
+        SettlementReport result;
+        for (SettlementReport& report : reports) result.merge(report);
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+SettlementEngine settlementEngine;
+
+// -------------------- Sales Analytics --------------------
+// Completed orders are copied into a column store, one row per order line
+// plus one row per order. Item names are interned to dense ids, so the
+// per-thread aggregation tables are plain arrays indexed by id; each query
+// splits the rows between workers and merges their tables at the end.
+struct HourDemand {
+    size_t orders = 0;
+    size_t items = 0;
+    double revenue = 0.0;
+};
+
+class SalesAnalytics {
+private:
+    // line columns
+    vector<uint32_t> line_item;
+    vector<uint8_t> line_is_combo;
+    vector<double> line_price;
+    // order columns
+    vector<uint8_t> order_hour;
+    vector<uint16_t> order_lines;
+    vector<uint8_t> order_has_combo;
+    vector<double> order_total;
+
+    unordered_map<string, uint32_t> item_ids;   // "F<food id>" / "C<combo id>"
+    vector<string> item_names;
+    unsigned workers;
+    mutable mutex store_lock;
+    time_t hour_start = 0;       // localtime_r() is slow, so the current hour is cached
+    uint8_t hour_of_day = 0;
+
+    static const size_t CHUNK = 1 << 16;
+
+    uint8_t hourOf(time_t when) {
+        if (when < hour_start || when >= hour_start + 3600) {
+            tm local;
+            localtime_r(&when, &local);
+            hour_start = when - local.tm_min * 60 - local.tm_sec;
+            hour_of_day = (uint8_t)local.tm_hour;
+        }
+        return hour_of_day;
+    }
+
+    uint32_t internItem(const string& key, const string& name) {
+        auto it = item_ids.find(key);
+        if (it != item_ids.end()) return it->second;
+        item_ids[key] = (uint32_t)item_names.size();
+        item_names.push_back(name);
+        return (uint32_t)item_names.size() - 1;
+    }
+
+    // fn(partial, begin, end) over chunks of n rows; returns one partial per worker
+    template <typename Partial, typename Fn>
+    vector<Partial> aggregate(size_t n, Partial init, Fn fn) const {
+        vector<Partial> partials(workers, init);
+        atomic<size_t> next{0};
+        runWorkers(workers, [&](unsigned w) {
+            for (size_t begin; (begin = next.fetch_add(CHUNK)) < n;) fn(partials[w], begin, min(n, begin + CHUNK));
+        });
+        return partials;
+    }
+
+public:
+    SalesAnalytics(unsigned _workers = 0) : workers(_workers ? _workers : max(1u, thread::hardware_concurrency())) {}
+
+    void record(Order& order) { record(order, order.getCreatedAt()); }
+
+    void record(Order& order, time_t when) {
+        vector<Food*> foods = order.getFoodItems();
+        vector<OrderLine> food_lines = order.getFoodLines();
+        vector<Combo> combos = order.getCombos();
+        vector<OrderLine> combo_lines = order.getComboLines();
+        lock_guard<mutex> lock(store_lock);
+        // revenue is what the line was sold for, not the menu price at query time
+        for (size_t i = 0; i < foods.size(); i++) {
+            line_item.push_back(internItem("F" + foods[i]->getId(), foods[i]->getName()));
+            line_is_combo.push_back(0);
+            line_price.push_back(food_lines[i].price);
+        }
+        for (size_t i = 0; i < combos.size(); i++) {
+            line_item.push_back(internItem("C" + combos[i].getComboId(), combos[i].getComboName()));
+            line_is_combo.push_back(1);
+            line_price.push_back(combo_lines[i].price);
+        }
+        order_hour.push_back(hourOf(when));
+        order_lines.push_back((uint16_t)min<size_t>(foods.size() + combos.size(), UINT16_MAX));
+        order_has_combo.push_back(!combos.empty());
+        order_total.push_back(order.getTotalPrice());
+    }
+
+    size_t getLineCount() const { lock_guard<mutex> lock(store_lock); return line_item.size(); }
+    size_t getOrderCount() const { lock_guard<mutex> lock(store_lock); return order_total.size(); }
+
+    // food items only; combos are reported through the attach rate
+    vector<pair<string, double>> topItems(size_t n) const {
+        lock_guard<mutex> lock(store_lock);
+        vector<vector<double>> partials = aggregate(line_item.size(), vector<double>(item_names.size(), 0.0),
+            [&](vector<double>& revenue, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (!line_is_combo[i]) revenue[line_item[i]] += line_price[i];
+                }
+            });
+        vector<double> revenue(item_names.size(), 0.0);
+        for (vector<double>& partial : partials) {
+            for (size_t id = 0; id < revenue.size(); id++) revenue[id] += partial[id];
+        }
+
+        vector<pair<string, double>> top;
+        for (size_t id = 0; id < revenue.size(); id++) {
+            if (revenue[id] > 0.0) top.push_back({item_names[id], revenue[id]});
+        }
+        n = min(n, top.size());
+        partial_sort(top.begin(), top.begin() + n, top.end(),
+                     [](const pair<string, double>& a, const pair<string, double>& b) { return a.second > b.second; });
+        top.resize(n);
+        return top;
+    }
+
+    // share of orders with at least one combo
+    double comboAttachRate() const {
+        lock_guard<mutex> lock(store_lock);
+        if (order_has_combo.empty()) return 0.0;
+        vector<size_t> partials = aggregate(order_has_combo.size(), (size_t)0, [&](size_t& count, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) count += order_has_combo[i];
+        });
+        size_t with_combo = 0;
+        for (size_t c : partials) with_combo += c;
+        return (double)with_combo / order_has_combo.size();
+    }
+
+    array<HourDemand, 24> hourlyDemand() const {
+        lock_guard<mutex> lock(store_lock);
+        vector<array<HourDemand, 24>> partials = aggregate(order_hour.size(), array<HourDemand, 24>(),
+            [&](array<HourDemand, 24>& hours, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    HourDemand& h = hours[order_hour[i]];
+                    h.orders++;
+                    h.items += order_lines[i];
+                    h.revenue += order_total[i];
+                }
+            });
+        array<HourDemand, 24> result;
+        for (auto& partial : partials) {
+            for (int h = 0; h < 24; h++) {
+                result[h].orders += partial[h].orders;
+                result[h].items += partial[h].items;
+                result[h].revenue += partial[h].revenue;
+            }
+        }
+        return result;
+    }
+
+    // average lines per order
+    double averageBasketSize() const {
+        lock_guard<mutex> lock(store_lock);
+        if (order_lines.empty()) return 0.0;
+        vector<size_t> partials = aggregate(order_lines.size(), (size_t)0, [&](size_t& lines, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) lines += order_lines[i];
+        });
+        size_t lines = 0;
+        for (size_t l : partials) lines += l;
+        return (double)lines / order_lines.size();
+    }
+
+    void display(size_t top_n = 5, ostream& out = cout) {
+        out << "=== Sales Analytics ===" << endl;
+        out << "Orders: " << getOrderCount() << ", lines: " << getLineCount() << endl;
+        out << "Top items by revenue:" << endl;
+        for (auto& item : topItems(top_n)) {
+            out << "  " << item.first << ": $" << fixed << setprecision(2) << item.second << endl;
+        }
+        out << "Combo attach rate: " << fixed << setprecision(1) << comboAttachRate() * 100 << "%" << endl;
+        out << "Average basket size: " << setprecision(2) << averageBasketSize() << " items" << endl;
+        out << "Hourly demand:" << endl;
+        array<HourDemand, 24> hours = hourlyDemand();
+        for (int h = 0; h < 24; h++) {
+            if (hours[h].orders == 0) continue;
+            out << "  " << setw(2) << setfill('0') << h << ":00  " << setfill(' ') << hours[h].orders
+                 << " orders, $" << hours[h].revenue << endl;
+        }
+        out << "=======================" << endl;
+    }
+};
+SalesAnalytics salesAnalytics;
+
+// -------------------- Demand Forecast --------------------
+// Units sold per food and hour of the week, folded across weeks with simple
+// exponential smoothing. Completed orders only queue their units; a
+// background thread applies them, refits the touched series and publishes a
+// fresh read-only table, so a forecast query is a lookup and a few adds. Weeks
+// that passed without sales are decayed when the table is read, so a slot
+// that stopped selling fades even if nothing new is recorded.
+struct ForecastTable {
+    struct Entry {
+        float current;   // forecast while the entry's week is still running
+        float closed;    // forecast once that week is over, before decay
+        int32_t week;    // last week with sales, -1 for none
+    };
+    unordered_map<string, uint32_t> ids;   // food id -> row
+    vector<Entry> units;                   // row * HOURS_PER_WEEK + hour of week
+};
+
+class DemandForecaster {
+public:
+    static const int HOURS_PER_WEEK = 168;
+
+private:
+    struct Sale {
+        string food_id;
+        time_t when;
+        int units;
+    };
+    struct Slot {
+        long week = -1;          // week the current count belongs to
+        double count = 0.0;
+        double smoothed = 0.0;
+        bool has_history = false;
+
+        double forecast() const { return has_history ? smoothed : count; }
+        double closedForecast(double alpha) const { return has_history ? alpha * count + (1 - alpha) * smoothed : count; }
+    };
+
+    double alpha;
+    vector<Sale> pending;
+    unordered_map<string, uint32_t> ids;   // model rows; only the worker touches these
+    vector<array<Slot, HOURS_PER_WEEK>> series;
+    shared_ptr<const ForecastTable> table = make_shared<ForecastTable>();
+    size_t applied = 0;
+    size_t queued = 0;
+    bool stopping = false;
+    mutex forecast_lock;
+    condition_variable work_ready;
+    condition_variable published;
+    thread worker;
+
+    // The offset is looked up per timestamp so hours follow DST changes. It is
+    // cached per quarter hour, since zone offsets only change on those.
+    static long localSeconds(time_t t) {
+        static thread_local time_t cached_quarter = -1;
+        static thread_local long cached_offset = 0;
+        if (t / 900 != cached_quarter) {
+            tm local;
+            localtime_r(&t, &local);
+            cached_offset = local.tm_gmtoff;
+            cached_quarter = t / 900;
+        }
+        return (long)t + cached_offset;
+    }
+
+    // the epoch started on a Thursday; hour 0 is Monday 00:00
+    int hourOfWeek(time_t t) const {
+        long hours = localSeconds(t) / 3600;
+        return (int)((hours + 3 * 24) % HOURS_PER_WEEK);
+    }
+    long weekOf(time_t t) const { return (localSeconds(t) / 3600 + 3 * 24) / HOURS_PER_WEEK; }
+
+    void apply(const Sale& sale) {
+        auto it = ids.find(sale.food_id);
+        if (it == ids.end()) {
+            it = ids.emplace(sale.food_id, (uint32_t)series.size()).first;
+            series.emplace_back();
+        }
+        Slot& slot = series[it->second][hourOfWeek(sale.when)];
+        long week = weekOf(sale.when);
+        if (week > slot.week) {
+            if (slot.week >= 0) {
+                // close the old week, then decay through any weeks with no sales
+                slot.smoothed = slot.closedForecast(alpha);
+                slot.has_history = true;
+                for (long w = slot.week + 1; w < week; w++) slot.smoothed *= (1 - alpha);
+            }
+            slot.week = week;
+            slot.count = 0.0;
+        }
+        if (week == slot.week) slot.count += sale.units;   // late sales for a closed week are dropped
+    }
+
+    void publish() {
+        shared_ptr<ForecastTable> next = make_shared<ForecastTable>();
+        next->ids = ids;
+        next->units.resize(series.size() * HOURS_PER_WEEK);
+        for (size_t row = 0; row < series.size(); row++) {
+            for (int h = 0; h < HOURS_PER_WEEK; h++) {
+                const Slot& slot = series[row][h];
+                next->units[row * HOURS_PER_WEEK + h] = {(float)slot.forecast(), (float)slot.closedForecast(alpha), (int32_t)slot.week};
+            }
+        }
+        atomic_store(&table, shared_ptr<const ForecastTable>(next));
+    }
+
+    void workerLoop() {
+        vector<Sale> batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(forecast_lock);
+                work_ready.wait(lock, [&] { return stopping || !pending.empty(); });
+                if (pending.empty()) return;
+                batch.swap(pending);
+            }
+            for (const Sale& sale : batch) apply(sale);
+            publish();
+            {
+                lock_guard<mutex> lock(forecast_lock);
+                applied += batch.size();
+            }
+            published.notify_all();
+            batch.clear();
+        }
+    }
+
+public:
+    DemandForecaster(double _alpha = 0.3) : alpha(_alpha) {}
+
+    ~DemandForecaster() {
+        {
+            lock_guard<mutex> lock(forecast_lock);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // combos count as the foods they contain, since those are what the kitchen preps
+    void record(Order& order, time_t when = time(nullptr)) {
+        vector<Sale> sales;
+        for (Food* food : order.getFoodItems()) sales.push_back({food->getId(), when, 1});
+        for (Combo& combo : order.getCombos()) {
+            for (Food* food : combo.getFoodItems()) sales.push_back({food->getId(), when, 1});
+        }
+        if (sales.empty()) return;
+
+        lock_guard<mutex> lock(forecast_lock);
+        pending.insert(pending.end(), sales.begin(), sales.end());
+        queued += sales.size();
+        if (!worker.joinable()) worker = thread(&DemandForecaster::workerLoop, this);
+        work_ready.notify_one();
+    }
+
+    // expected units of one food over the hours starting at from
+    double expectedUnits(const string& food_id, time_t from, int hours = 2) const {
+        shared_ptr<const ForecastTable> current = atomic_load(&table);
+        auto it = current->ids.find(food_id);
+        if (it == current->ids.end()) return 0.0;
+        const ForecastTable::Entry* row = &current->units[(size_t)it->second * HOURS_PER_WEEK];
+        double total = 0.0;
+        for (int h = 0; h < hours; h++) {
+            time_t t = from + (time_t)h * 3600;
+            const ForecastTable::Entry& entry = row[hourOfWeek(t)];
+            long week = weekOf(t);
+            if (week <= entry.week) total += entry.current;
+            else total += entry.closed * pow(1 - alpha, (double)(week - entry.week - 1));
+        }
+        return total;
+    }
+
+    // blocks until every recorded sale is reflected in the published table
+    void waitUntilPublished() {
+        unique_lock<mutex> lock(forecast_lock);
+        published.wait(lock, [&] { return applied == queued; });
+    }
+
+    void displayPrepForecast(time_t from = time(nullptr), int hours = 2, ostream& out = cout) {
+        out << "=== Prep Forecast (next " << hours << " hours) ===" << endl;
+        bool any = false;
+        auto menu = menuStore.read();
+        for (auto& pair : menu->foods) {
+            double units = expectedUnits(pair.first, from, hours);
+            if (units < 0.05) continue;
+            out << pair.second->getName() << ": " << fixed << setprecision(1) << units << " units" << endl;
+            any = true;
+        }
+        if (!any) out << "No demand history yet." << endl;
+        out << "===================================" << endl;
+    }
+};
+DemandForecaster demandForecaster;
+
+void onOrderCompleted(Order& order) {
+    salesAnalytics.record(order);
+    demandForecaster.record(order);
+}
+
+// -------------------- Payment helpers --------------------
+struct PaymentSubmission {
+    shared_future<PaymentResult> result;
+    bool duplicate = false;   // same order and attempt was already submitted
+    bool invalid = false;     // the card could not be stored; nothing was submitted
+};
+
+string paymentKey(Order& order) {
+    return order.getOrderId() + "#" + to_string(order.getPaymentAttempt());
+}
+
+// index and pipeline default to the shared ones; a branch shard passes its own
+PaymentSubmission authorizePayment(Order& order, PaymentMethod* payment, IdempotencyIndex& index = paymentIdempotency,
+                                   PaymentPipeline& pipeline = paymentPipeline) {
+    PaymentSubmission sub;
+    if (!payment->isValid()) {
+        sub.invalid = true;
+        return sub;
+    }
+    sub.result = index.findOrAdd(paymentKey(order), [&]() {
+        AuthRequest request{order.getOrderId(), payment->getMethodName(), payment->getAmount(), payment->getCurrency(),
+                            payment->getCardToken(), paymentKey(order)};
+        return pipeline.submit(request).share();
+    }, sub.duplicate);
+    return sub;
+}
+
+// cash needs no gateway, but goes through the same key so a repeat is not recorded twice
+PaymentSubmission acceptCashPayment(Order& order, IdempotencyIndex& index = paymentIdempotency) {
+    PaymentSubmission sub;
+    sub.result = index.findOrAdd(paymentKey(order), []() {
+        promise<PaymentResult> done;
+        PaymentResult result;
+        result.status = PaymentStatus::Approved;
+        result.auth_code = "CASH";
+        result.attempts = 1;
+        done.set_value(result);
+        return done.get_future().share();
+    }, sub.duplicate);
+    return sub;
+}
+
+// A declined attempt is over and the next one gets a new key. A timed-out or
+// failed attempt may still have been approved, so the next submit reuses its
+// key and the gateway answers with the original result instead of charging again.
+void closePaymentAttempt(Order& order, PaymentStatus status, IdempotencyIndex& index = paymentIdempotency) {
+    if (status == PaymentStatus::Declined) order.nextPaymentAttempt();
+    else index.forget(paymentKey(order));
+}
+
+// records an authorized payment, or releases it if the gateway said no
+void applyPaymentResult(Order& order, PaymentMethod* payment, const PaymentResult& result, ostream& out = cout) {
+    if (result.status == PaymentStatus::Approved) {
+        payment->releaseCard();
+        order.markPaid(payment);
+        paymentManager.addPayment(payment, order.getOrderId(), order.getTotalPrice());
+        out << "Payment approved for order " << order.getOrderId() << " (auth " << result.auth_code << ")" << endl;
+    } else {
+        if (order.getPaymentMethod() == payment) order.setPaymentMethod(nullptr);
+        closePaymentAttempt(order, result.status);
+        paymentSlab.destroy(payment);
+        out << "Payment for order " << order.getOrderId()
+             << (result.status == PaymentStatus::Declined ? " was declined."
+                 : result.status == PaymentStatus::Failed ? " could not reach the payment gateway, please try again."
+                 : " timed out, please try again.") << endl;
+    }
+}
+
+// -------------------- Audit Trail --------------------
+// Admin actions are appended as fixed 64-byte records to files mapped into
+// memory, so recording one is a copy into the page cache and a query is a
+// scan over packed records. Each file holds a fixed number of records; when
+// it fills, appends move to a spare file that a background thread keeps
+// ready, and the same thread flushes sealed files and deletes the oldest ones
+// beyond the retention limit. That is all the maintenance there is: files are
+// rotated and retired whole, never compacted or merged, so a record lives
+// until its file is deleted. Until open() is called the log lives in
+// anonymous memory. openReadOnly() maps the files for queries only, with no
+// spare file and no rotation.
+enum class AuditAction : uint8_t { OrderStatus = 1, ReservationStatus, Promotion, Refund, Restock };
+
+const char* auditActionName(AuditAction action) {
+    switch (action) {
+        case AuditAction::OrderStatus: return "order-status";
+        case AuditAction::ReservationStatus: return "reservation-status";
+        case AuditAction::Promotion: return "promotion";
+        case AuditAction::Refund: return "refund";
+        case AuditAction::Restock: return "restock";
+    }
+    return "unknown";
+}
+
+// before/after hold the status code for status changes, refunded cents for
+// refunds and the stock level for restocks
+struct AuditRecord {
+    int64_t time_us;       // 0 marks an unused slot
+    int64_t before;
+    int64_t after;
+    char actor[16];        // zero-padded, truncated
+    char target[22];
+    uint8_t action;
+    uint8_t reserved;
+
+    static void pack(char* field, size_t size, string_view text) {
+        size_t n = min(size, text.size());
+        memcpy(field, text.data(), n);
+        memset(field + n, 0, size - n);
+    }
+
+    string getActor() const { return string(actor, strnlen(actor, sizeof(actor))); }
+    string getTarget() const { return string(target, strnlen(target, sizeof(target))); }
+    AuditAction getAction() const { return static_cast<AuditAction>(action); }
+
+    void display(ostream& out = cout) const {
+        time_t seconds = time_us / 1000000;
+        char when[32];
+        tm local;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime_r(&seconds, &local));
+        out << when << "  " << getActor() << "  " << auditActionName(getAction()) << "  " << getTarget()
+            << "  " << before << " -> " << after << "\n";
+    }
+};
+static_assert(sizeof(AuditRecord) == 64, "audit records are fixed-size");
+
+struct AuditQuery {
+    string actor;                   // "" = any
+    string target;                  // "" = any
+    AuditAction action{};           // 0 = any
+    int64_t from_us = 0;
+    int64_t to_us = INT64_MAX;      // exclusive
+};
+
+class AuditSegment {
+private:
+    AuditRecord* records;
+    size_t capacity;
+    atomic<size_t> count{0};
+
+public:
+    const string path;   // empty for anonymous memory
+
+    AuditSegment(string _path, size_t _capacity, bool read_only = false) : capacity(_capacity), path(move(_path)) {
+        void* region;
+        if (path.empty()) {
+            region = mmap(nullptr, capacity * sizeof(AuditRecord), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        } else if (read_only) {
+            // mapped as it is on disk; an empty file maps nothing
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw runtime_error("audit log: cannot open " + path);
+            capacity = (size_t)lseek(fd, 0, SEEK_END) / sizeof(AuditRecord);
+            region = capacity == 0 ? nullptr : mmap(nullptr, capacity * sizeof(AuditRecord), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+        } else {
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0) throw runtime_error("audit log: cannot open " + path);
+            off_t size = lseek(fd, 0, SEEK_END);
+            capacity = max(capacity, (size_t)size / sizeof(AuditRecord));
+            if (ftruncate(fd, capacity * sizeof(AuditRecord)) < 0) {
+                ::close(fd);
+                throw runtime_error("audit log: cannot size " + path);
+            }
+            region = mmap(nullptr, capacity * sizeof(AuditRecord), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+        }
+        if (region == MAP_FAILED) throw runtime_error("audit log: cannot map memory");
+        records = (AuditRecord*)region;
+        // a reopened file is full up to its first unused slot
+        size_t used = 0;
+        while (used < capacity && records[used].time_us != 0) used++;
+        count.store(used);
+    }
+
+    ~AuditSegment() {
+        if (records != nullptr) munmap(records, capacity * sizeof(AuditRecord));
+    }
+
+    bool isFull() const { return count.load(memory_order_relaxed) == capacity; }
+    size_t size() const { return count.load(memory_order_acquire); }
+
+    // single writer, serialized by the log
+    void append(const AuditRecord& record) {
+        size_t n = count.load(memory_order_relaxed);
+        records[n] = record;
+        count.store(n + 1, memory_order_release);
+    }
+
+    void flush() {
+        if (!path.empty()) msync(records, capacity * sizeof(AuditRecord), MS_ASYNC);
+    }
+
+    // records are appended in time order, so the range is found by binary search
+    template <typename Fn>
+    void scan(int64_t from_us, int64_t to_us, Fn fn) const {
+        const AuditRecord* begin = records;
+        const AuditRecord* end = records + size();
+        if (begin == end || end[-1].time_us < from_us || begin->time_us >= to_us) return;
+        auto by_time = [](const AuditRecord& r, int64_t t) { return r.time_us < t; };
+        const AuditRecord* first = lower_bound(begin, end, from_us, by_time);
+        const AuditRecord* last = lower_bound(first, end, to_us, by_time);
+        for (const AuditRecord* r = first; r != last; ++r) fn(*r);
+    }
+};
+
+class AuditLog {
+private:
+    size_t records_per_file;
+    size_t max_files;
+    string prefix;
+    uint64_t next_file = 1;
+    vector<shared_ptr<AuditSegment>> segments;   // oldest first; the last one takes appends
+    shared_ptr<AuditSegment> spare;
+    vector<shared_ptr<AuditSegment>> sealed;     // full, waiting to be flushed
+    int64_t last_time_us = 0;
+    size_t maintenance_runs = 0;
+    bool read_only = false;
+    bool stopping = false;
+    mutable mutex log_lock;
+    condition_variable work_ready;
+    condition_variable maintained;
+    thread worker;
+
+    static int64_t nowMicros() {
+        return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    string nextPath() {
+        return prefix.empty() ? "" : prefix + "." + to_string(next_file++) + ".audit";
+    }
+
+    bool needsWork() const { return !read_only && (spare == nullptr || !sealed.empty() || segments.size() > max_files); }
+
+    void rotate() {
+        if (!segments.empty()) sealed.push_back(segments.back());
+        if (spare != nullptr) segments.push_back(move(spare));
+        else segments.push_back(make_shared<AuditSegment>(nextPath(), records_per_file));
+        work_ready.notify_one();
+    }
+
+    void workerLoop() {
+        unique_lock<mutex> lock(log_lock);
+        while (true) {
+            work_ready.wait(lock, [&] { return stopping || needsWork(); });
+            if (stopping) return;
+            if (spare == nullptr) {
+                string path = nextPath();
+                lock.unlock();
+                auto next = make_shared<AuditSegment>(path, records_per_file);
+                lock.lock();
+                if (spare == nullptr) spare = move(next);
+            }
+            vector<shared_ptr<AuditSegment>> dropped;
+            while (segments.size() > max_files) {
+                dropped.push_back(segments.front());
+                segments.erase(segments.begin());
+            }
+            vector<shared_ptr<AuditSegment>> to_flush;
+            to_flush.swap(sealed);
+            lock.unlock();
+            for (auto& segment : to_flush) segment->flush();
+            for (auto& segment : dropped) {
+                if (!segment->path.empty()) unlink(segment->path.c_str());
+            }
+            // readers may still hold dropped segments; they unmap with the last reference
+            dropped.clear();
+            to_flush.clear();
+            lock.lock();
+            maintenance_runs++;
+            maintained.notify_all();
+        }
+    }
+
+    vector<shared_ptr<AuditSegment>> snapshot() const {
+        lock_guard<mutex> lock(log_lock);
+        return segments;
+    }
+
+    void load(const string& _prefix, bool _read_only) {
+        string dir = ".", base = _prefix;
+        size_t slash = _prefix.rfind('/');
+        if (slash != string::npos) {
+            dir = slash == 0 ? "/" : _prefix.substr(0, slash);
+            base = _prefix.substr(slash + 1);
+        }
+        vector<uint64_t> existing;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent* entry = readdir(d)) {
+                string name = entry->d_name;
+                if (name.size() <= base.size() + 7 || name.compare(0, base.size() + 1, base + ".") != 0
+                    || name.compare(name.size() - 6, 6, ".audit") != 0) continue;
+                uint64_t n = 0;
+                const char* first = name.data() + base.size() + 1;
+                const char* last = name.data() + name.size() - 6;
+                auto parsed = from_chars(first, last, n);
+                if (parsed.ec == errc() && parsed.ptr == last && n > 0) existing.push_back(n);
+            }
+            closedir(d);
+        }
+        sort(existing.begin(), existing.end());
+
+        unique_lock<mutex> lock(log_lock);
+        // let the worker finish anything it started under the old prefix
+        maintained.wait(lock, [&] { return !needsWork(); });
+        if (spare != nullptr && !spare->path.empty()) unlink(spare->path.c_str());
+        prefix = _prefix;
+        read_only = _read_only;
+        segments.clear();
+        spare.reset();
+        for (uint64_t n : existing) {
+            segments.push_back(make_shared<AuditSegment>(prefix + "." + to_string(n) + ".audit", records_per_file, read_only));
+            next_file = n + 1;
+        }
+        last_time_us = 0;
+        if (!segments.empty()) {
+            segments.back()->scan(0, INT64_MAX, [&](const AuditRecord& r) { last_time_us = r.time_us; });
+        }
+        work_ready.notify_one();
+    }
+
+public:
+    AuditLog(size_t _records_per_file = 1 << 16, size_t _max_files = 64)
+        : records_per_file(_records_per_file), max_files(_max_files) {
+        worker = thread([this] { workerLoop(); });
+    }
+
+    ~AuditLog() {
+        {
+            lock_guard<mutex> lock(log_lock);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        worker.join();
+        for (auto& segment : segments) segment->flush();
+        if (spare != nullptr && !spare->path.empty()) unlink(spare->path.c_str());
+    }
+
+    // switches to files named <prefix>.<n>.audit, picking up the ones already there
+    void open(const string& _prefix) { load(_prefix, false); }
+
+    // for the query tool: maps the existing files read-only and never writes
+    void openReadOnly(const string& _prefix) { load(_prefix, true); }
+
+    // dropped on a read-only log
+    void record(string_view actor, AuditAction action, string_view target, int64_t before, int64_t after) {
+        AuditRecord r;
+        AuditRecord::pack(r.actor, sizeof(r.actor), actor);
+        AuditRecord::pack(r.target, sizeof(r.target), target);
+        r.action = static_cast<uint8_t>(action);
+        r.reserved = 0;
+        r.before = before;
+        r.after = after;
+        lock_guard<mutex> lock(log_lock);
+        if (read_only) return;
+        // keep each file sorted by time even if the wall clock steps back
+        r.time_us = last_time_us = max(nowMicros(), last_time_us);
+        if (segments.empty() || segments.back()->isFull()) rotate();
+        segments.back()->append(r);
+    }
+
+    // calls fn for every match, oldest first; appends carry on while it runs
+    template <typename Fn>
+    size_t scan(const AuditQuery& query, Fn fn) const {
+        char actor[sizeof(AuditRecord::actor)];
+        char target[sizeof(AuditRecord::target)];
+        AuditRecord::pack(actor, sizeof(actor), query.actor);
+        AuditRecord::pack(target, sizeof(target), query.target);
+        bool any_actor = query.actor.empty(), any_target = query.target.empty();
+        uint8_t action = static_cast<uint8_t>(query.action);
+        size_t matches = 0;
+        for (auto& segment : snapshot()) {
+            segment->scan(query.from_us, query.to_us, [&](const AuditRecord& r) {
+                if ((action == 0 || r.action == action) && (any_actor || memcmp(r.actor, actor, sizeof(actor)) == 0)
+                    && (any_target || memcmp(r.target, target, sizeof(target)) == 0)) {
+                    matches++;
+                    fn(r);
+                }
+            });
+        }
+        return matches;
+    }
+
+    vector<AuditRecord> query(const AuditQuery& q) const {
+        vector<AuditRecord> result;
+        scan(q, [&](const AuditRecord& r) { result.push_back(r); });
+        return result;
+    }
+
+    size_t count(const AuditQuery& q) const { return scan(q, [](const AuditRecord&) {}); }
+
+    size_t getRecordCount() const {
+        size_t total = 0;
+        for (auto& segment : snapshot()) total += segment->size();
+        return total;
+    }
+
+    size_t getFileCount() const { lock_guard<mutex> lock(log_lock); return segments.size(); }
+
+    // waits until the background thread has caught up with rotations
+    void waitForMaintenance() {
+        unique_lock<mutex> lock(log_lock);
+        work_ready.notify_one();
+        maintained.wait(lock, [&] { return !needsWork(); });
+    }
+};
+AuditLog auditLog;
+
+// -------------------- Sessions --------------------
+// Guest and staff menus are state machines fed one input line at a time, so
+// the same command set can run from a terminal or from the session engine.
+// The menu numbers are the protocol. Each step writes into the session's own
+// stream, which is handed back as the reply.
+class Session {
+protected:
+    bool closed = false;
+    stringstream out;   // output of the step being run
+
+    virtual void handle(const string& line) = 0;
+    virtual void showMenu() = 0;
+
+    template <typename Fn>
+    string capture(Fn fn) {
+        out.str("");
+        out.clear();
+        fn();
+        return out.str();
+    }
+
+    static bool parseInt(const string& text, int& value) {
+        stringstream ss(text);
+        return (ss >> value) && (ss >> ws).eof();
+    }
+
+public:
+    virtual ~Session() {}
+
+    string start() { return capture([&] { showMenu(); }); }
+
+    virtual string feed(string_view line) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.remove_suffix(1);
+        return capture([&] { handle(string(line)); });
+    }
+
+    // output that is not a reply to input, such as a finished payment
+    virtual string poll() { return ""; }
+    virtual bool hasPendingWork() { return false; }
+    // blocks until pending work is done and returns its output; used when a
+    // terminal session ends
+    virtual string finish() { return ""; }
+    // a login session hands over to the guest or staff session it opened
+    virtual unique_ptr<Session> takeNext() { return nullptr; }
+
+    bool isClosed() { return closed; }
+};
+
+class GuestSession : public Session {
+private:
+    User* guest;
+    Order& order;
+    vector<Reservation*>& reservations;
+    int command = 0;   // menu choice being answered, 0 at the menu
+    int step = 0;
+    int pay_choice = 0;
+    string currency;
+    string date;
+    string time_of_day;
+    shared_future<PaymentResult> pending_auth;   // card/e-wallet authorization in flight
+    PaymentMethod* pending_payment = nullptr;
+
+    void showMenu() override {
+        out << "\n--- Guest Menu ---\n";
+        int unread = notificationManager.getUnreadCount();
+        if (unread > 0) {
+            out << " [" << unread << " unread notifications]";
+        }
+        out << "\n";
+        out << "1. Show Menu\n";
+        out << "2. Show Order\n";
+        out << "3. Cancel Order (Pending only)\n";
+        out << "4. View Notifications\n";
+        out << "5. View Unread Notifications\n";
+        out << "6. Notification Settings\n";
+        out << "7. Payment Menu\n";
+        out << "8. Make a Reservation\n";
+        out << "9. View Reservations\n";
+        out << "10. Cancel Reservation\n";
+        out << "11. Search Menu\n";
+        out << "0. Exit\n";
+        out << "Choose: ";
+    }
+
+    void applyPendingPayment() {
+        if (pending_payment != nullptr && pending_auth.wait_for(chrono::seconds(0)) == future_status::ready) {
+            applyPaymentResult(order, pending_payment, pending_auth.get(), out);
+            pending_payment = nullptr;
+        }
+    }
+
+    void startAuthorization(PaymentMethod* payment, string label) {
+        PaymentSubmission sub = authorizePayment(order, payment);
+        if (sub.invalid || sub.duplicate) {
+            paymentSlab.destroy(payment);
+            out << (sub.invalid ? "Invalid card number!" : "This payment was already submitted.") << endl;
+        } else {
+            out << "Authorizing " << label << "..." << endl;
+            order.setPaymentMethod(payment);
+            pending_auth = sub.result;
+            pending_payment = payment;
+        }
+    }
+
+    // returns true once the command has everything it needs
+    bool choose(int choice) {
+        if (choice == 1) {
+            displayAllFood(out);
+        } else if (choice == 2) {
+            order.display(out);
+        } else if (choice == 3) {
+            if (order.getStatus() == OrderStatus::Pending) {
+                order.setStatus(OrderStatus::Cancelled);
+                out << "Order cancelled!\n";
+            } else {
+                out << "Cannot cancel order (not Pending).\n";
+            }
+        } else if (choice == 4) {
+            notificationManager.showAllNotifications(out);
+        } else if (choice == 5) {
+            notificationManager.showUnreadNotifications(out);
+        } else if (choice == 6) {
+            out << "1. Enable notifications\n2. Disable notifications\nChoose: ";
+            return false;
+        } else if (choice == 7 && (pending_payment != nullptr || order.isPaid())) {
+            out << (order.isPaid() ? "Order is already paid." : "A payment is still being authorized.") << endl;
+        } else if (choice == 7) {
+            out << "\n--- Payment Menu ---\n";
+            out << "1. Cash\n";
+            out << "2. Credit Card" << endl;
+            out << "3. e-Wallet" << endl;
+            out << "Choose payment method: ";
+            return false;
+        } else if (choice == 8) {
+            out << "Enter date (YYYY-MM-DD): ";
+            return false;
+        } else if (choice == 9) {
+            out << "\n=== Your Reservations ===\n";
+            bool hasReservations = false;
+            for (Reservation* res : reservations) {
+                if (res->getCustomer() == guest) {
+                    res->displayInfo(out);
+                    hasReservations = true;
+                }
+            }
+            if (!hasReservations) {
+                out << "No reservations found." << endl;
+            }
+        } else if (choice == 10) {
+            out << "Enter Reservation ID to cancel: ";
+            return false;
+        } else if (choice == 11) {
+            out << "Search (name, broth, protein, ...): ";
+            return false;
+        }
+        return true;
+    }
+
+    bool answer(const string& line) {
+        int value = 0;
+        if (command == 6) {
+            if (parseInt(line, value) && value == 1) notificationManager.enablePushNotifications(out);
+            else if (value == 2) notificationManager.disablePushNotifications(out);
+            return true;
+        }
+        if (command == 7) {
+            if (step == 0) {
+                if (!parseInt(line, pay_choice)) return true;
+                if (pay_choice == 1) out << "Enter currency (e.g., USD, VND): ";
+                else if (pay_choice == 2) out << "Enter 16-digit card number: ";
+                else if (pay_choice == 3) out << "Enter e-Wallet name (e.g., PayPal, Momo): ";
+                else return true;
+                return false;
+            }
+            if (pay_choice == 1 && step == 1) {
+                currency = line;
+                out << "Enter cash amount: $";
+                return false;
+            }
+            if (pay_choice == 1) {
+                double cash = atof(line.c_str());
+                if (cash < order.getTotalPrice()) out << "Not enough cash!" << endl;
+                else if (acceptCashPayment(order).duplicate) out << "This payment was already recorded." << endl;
+                else {
+                    PaymentMethod* payment = paymentSlab.make<CashPayment>(cash, currency);
+                    out << "Payment successful!" << endl;
+                    out << "Change: $" << cash - order.getTotalPrice() << endl;
+                    order.markPaid(payment);
+                    paymentManager.addPayment(payment, order.getOrderId(), order.getTotalPrice());
+                }
+            } else if (pay_choice == 2) {
+                if (line.size() != 16) out << "Invalid card number!" << endl;
+                else startAuthorization(paymentSlab.make<CreditPayment>(order.getTotalPrice(), line), "Credit Card payment");
+            } else {
+                startAuthorization(paymentSlab.make<eWalletPayment>(order.getTotalPrice(), line), "e-Wallet payment (" + line + ")");
+            }
+            return true;
+        }
+        if (command == 8) {
+            if (step == 0) {
+                date = line;
+                out << "Enter time (HH:MM): ";
+                return false;
+            }
+            if (step == 1) {
+                time_of_day = line;
+                out << "Enter party size: ";
+                return false;
+            }
+            int party_size = 0;
+            parseInt(line, party_size);
+            Reservation* newRes = reservationSlab.make<Reservation>(guest, date, time_of_day, party_size);
+            reservations.push_back(newRes);
+            out << "Reservation created, waiting to confirm" << endl;
+            newRes->displayInfo(out);
+            return true;
+        }
+        if (command == 11) {
+            menuSearch.displayResults(line, out);
+            return true;
+        }
+        if (command == 10) {
+            for (Reservation* res : reservations) {
+                if (res->getReservationID() == line && res->getCustomer() == guest) {
+                    if (res->getStatus() == "Pending" || res->getStatus() == "Confirmed") {
+                        res->setStatus("Cancelled");
+                        out << "Reservation cancelled." << endl;
+                    } else {
+                        out << "Cannot cancel this reservation." << endl;
+                    }
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    void handle(const string& line) override {
+        applyPendingPayment();
+        bool done;
+        if (command == 0) {
+            int choice = -1;
+            parseInt(line, choice);
+            if (choice == 0) {
+                closed = true;
+                return;
+            }
+            command = choice;
+            step = 0;
+            done = choose(choice);
+        } else {
+            done = answer(line);
+            step++;
+        }
+        if (done) {
+            command = 0;
+            showMenu();
+        }
+    }
+
+public:
+    GuestSession(User* _guest, Order& _order, vector<Reservation*>& _reservations)
+        : guest(_guest), order(_order), reservations(_reservations) {}
+
+    string poll() override { return capture([&] { applyPendingPayment(); }); }
+    bool hasPendingWork() override { return pending_payment != nullptr; }
+
+    string finish() override {
+        string output = capture([&] {
+            if (pending_payment != nullptr) applyPaymentResult(order, pending_payment, pending_auth.get(), out);
+        });
+        pending_payment = nullptr;
+        return output;
+    }
+};
+
+class AdminSession : public Session {
+private:
+    Staff& staff;
+    vector<Order*>& orders;
+    vector<Reservation*>& reservations;
+    int command = 0;
+    int step = 0;
+    Order* target_order = nullptr;
+    Reservation* target_reservation = nullptr;
+    int line_type = 0;
+    string ingredient;
+
+    void showMenu() override {
+        out << "\n--- Admin Menu ---\n";
+        out << "1. Show all food\n";
+        out << "2. Show all orders\n";
+        out << "3. Update order status\n";
+        out << "4. View all reservations\n";
+        out << "5. Confirm/Update reservation\n";
+        out << "6. Send promotion\n";
+        out << "7. Show Payment History\n";
+        out << "8. Show Today's Revenue\n";
+        out << "9. Refund order line\n";
+        out << "10. End-of-day settlement\n";
+        out << "11. Sales analytics\n";
+        out << "12. Prep forecast\n";
+        out << "13. Ingredient stock\n";
+        out << "14. System metrics\n";
+        out << "0. Exit\n";
+        out << "Choose: ";
+    }
+
+    Order* findOrder(const string& id) {
+        for (Order* o : orders) {
+            if (o->getOrderId() == id) return o;
+        }
+        return nullptr;
+    }
+
+    // the permission each menu option needs, checked again on every step so a
+    // role change applies to a session that is already open
+    static uint32_t requiredPermission(int choice) {
+        static const uint32_t required[] = {
+            0, PERM_VIEW_MENU, PERM_VIEW_ORDERS, PERM_UPDATE_ORDER, PERM_VIEW_RESERVATIONS,
+            PERM_UPDATE_RESERVATION, PERM_SEND_PROMOTION, PERM_VIEW_PAYMENTS, PERM_VIEW_PAYMENTS,
+            PERM_REFUND, PERM_REPORTS, PERM_REPORTS, PERM_KITCHEN, PERM_KITCHEN, PERM_REPORTS,
+        };
+        return choice > 0 && choice < 15 ? required[choice] : 0;
+    }
+
+    bool choose(int choice) {
+        if (choice == 1) {
+            displayAllFood(out);
+        } else if (choice == 2) {
+            for (Order* o : orders) {
+                o->display(out);
+            }
+        } else if (choice == 3 || choice == 9) {
+            out << "Enter Order ID: ";
+            return false;
+        } else if (choice == 4) {
+            out << "\n=== All Reservations ===\n";
+            if (reservations.empty()) {
+                out << "No reservations found.\n";
+            } else {
+                for (Reservation* res : reservations) {
+                    res->displayInfo(out);
+                }
+            }
+        } else if (choice == 5) {
+            out << "Enter Reservation ID: ";
+            return false;
+        } else if (choice == 6) {
+            out << "Enter promotion message: ";
+            return false;
+        } else if (choice == 7) {
+            paymentManager.displayAllPayments(out);
+        } else if (choice == 8) {
+            paymentManager.displayTodayRevenue(out);
+        } else if (choice == 10) {
+            refundEngine.waitUntilProcessed();
+            settlementEngine.settle(orders, paymentManager.getLedger(), startOfToday(), time(nullptr) + 1).display(10, out);
+        } else if (choice == 11) {
+            salesAnalytics.display(5, out);
+        } else if (choice == 12) {
+            demandForecaster.displayPrepForecast(time(nullptr), 2, out);
+        } else if (choice == 13) {
+            inventory.displayStock(out);
+            out << "Ingredient to restock (blank to skip): ";
+            return false;
+        } else if (choice == 14) {
+            metrics.writeText(out);
+        }
+        return true;
+    }
+
+    bool answer(const string& line) {
+        int value = 0;
+        if (command == 3) {
+            if (step == 0) {
+                target_order = findOrder(line);
+                if (target_order == nullptr) return true;
+                out << "Choose status (0=Pending,1=Preparing,2=Completed,3=Cancelled): ";
+                return false;
+            }
+            if (parseInt(line, value) && value >= 0 && value <= 3) {
+                int before = (int)target_order->getStatus();
+                if (target_order->setStatus(static_cast<OrderStatus>(value))) {
+                    auditLog.record(staff.getUsername(), AuditAction::OrderStatus, target_order->getOrderId(), before, value);
+                    out << "Order " << target_order->getOrderId() << " status updated!\n";
+                } else {
+                    out << "Order " << target_order->getOrderId() << " is already completed or cancelled.\n";
+                }
+            }
+            return true;
+        }
+        if (command == 5) {
+            if (step == 0) {
+                target_reservation = nullptr;
+                for (Reservation* res : reservations) {
+                    if (res->getReservationID() == line) target_reservation = res;
+                }
+                if (target_reservation == nullptr) return true;
+                out << "Choose status:\n";
+                out << "1. Pending\n2. Confirmed\n3. Cancelled\n4. Completed\n";
+                out << "Choose: ";
+                return false;
+            }
+            parseInt(line, value);
+            const string statuses[] = {"", "Pending", "Confirmed", "Cancelled", "Completed"};
+            string status = value >= 1 && value <= 4 ? statuses[value] : "";
+            int before = find(begin(statuses), end(statuses), target_reservation->getStatus()) - begin(statuses);
+            auditLog.record(staff.getUsername(), AuditAction::ReservationStatus, target_reservation->getReservationID(),
+                            before < 5 ? before : 0, status.empty() ? 0 : value);
+            target_reservation->setStatus(status);
+            out << "Reservation " << target_reservation->getReservationID() << " status updated to " << status << "!\n";
+            return true;
+        }
+        if (command == 6) {
+            auditLog.record(staff.getUsername(), AuditAction::Promotion, line, 0, (int64_t)line.size());
+            notificationManager.sendPromotion(line);
+            return true;
+        }
+        if (command == 9) {
+            if (step == 0) {
+                target_order = findOrder(line);
+                if (target_order == nullptr) return true;
+                out << "Line type (1=Food, 2=Combo): ";
+                return false;
+            }
+            if (step == 1) {
+                parseInt(line, line_type);
+                out << "Line number (starting at 1): ";
+                return false;
+            }
+            parseInt(line, value);
+            int64_t refunded_before = llround(refundEngine.getRefundedAmount(target_order->getOrderId()) * 100);
+            string refund_id = line_type == 1 ? refundEngine.refundLines(*target_order, {value - 1}, {})
+                                              : refundEngine.refundLines(*target_order, {}, {value - 1});
+            if (!refund_id.empty()) {
+                auditLog.record(staff.getUsername(), AuditAction::Refund, target_order->getOrderId(), refunded_before,
+                                llround(refundEngine.getRefundedAmount(target_order->getOrderId()) * 100));
+            }
+            if (refund_id.empty()) out << "Nothing to refund for that line.\n";
+            else out << "Refund " << refund_id << " queued.\n";
+            return true;
+        }
+        if (command == 13) {
+            if (step == 0) {
+                ingredient = line;
+                if (ingredient.empty()) return true;
+                out << "Quantity to add: ";
+                return false;
+            }
+            long long stock_before = inventory.getStock(ingredient);
+            inventory.addStock(ingredient, atoll(line.c_str()));
+            auditLog.record(staff.getUsername(), AuditAction::Restock, ingredient, stock_before, inventory.getStock(ingredient));
+            out << ingredient << " now at " << inventory.getStock(ingredient) << endl;
+        }
+        return true;
+    }
+
+    void handle(const string& line) override {
+        bool done;
+        if (command == 0) {
+            int choice = -1;
+            parseInt(line, choice);
+            if (choice == 0) {
+                closed = true;
+                return;
+            }
+            command = choice;
+            step = 0;
+            if (!staff.can(requiredPermission(choice))) {
+                out << "Permission denied.\n";
+                done = true;
+            } else {
+                done = choose(choice);
+            }
+        } else if (!staff.can(requiredPermission(command))) {
+            out << "Permission denied.\n";
+            done = true;
+        } else {
+            done = answer(line);
+            step++;
+        }
+        if (done) {
+            command = 0;
+            showMenu();
+        }
+    }
+
+public:
+    AdminSession(Staff& _staff, vector<Order*>& _orders, vector<Reservation*>& _reservations)
+        : staff(_staff), orders(_orders), reservations(_reservations) {}
+};
+
+// asks for credentials, then opens a guest session (with a fresh order) or a staff session
+class LoginSession : public Session {
+private:
+    AccountManager& accounts;
+    vector<Order*>& orders;
+    vector<Reservation*>& reservations;
+    string username;
+    bool asking_password = false;
+    unique_ptr<Session> next;
+
+    void showMenu() override { out << "Username: "; }
+
+    void handle(const string& line) override {
+        if (!asking_password) {
+            username = line;
+            asking_password = true;
+            out << "Password: ";
+            return;
+        }
+        asking_password = false;
+        User* user = accounts.authenticate(username, line);
+        if (user == nullptr) {
+            out << "Login failed.\n";
+            showMenu();
+            return;
+        }
+        out << "Login successful! Welcome, " << user->getUsername() << " (" << user->getRole() << ")\n";
+        if (Staff* staff = dynamic_cast<Staff*>(user)) {
+            next.reset(new AdminSession(*staff, orders, reservations));
+        } else {
+            Order* order = orderSlab.make<Order>(user);
+            orders.push_back(order);
+            next.reset(new GuestSession(user, *order, reservations));
+        }
+        out << next->start();
+    }
+
+public:
+    LoginSession(AccountManager& _accounts, vector<Order*>& _orders, vector<Reservation*>& _reservations)
+        : accounts(_accounts), orders(_orders), reservations(_reservations) {}
+
+    unique_ptr<Session> takeNext() override { return move(next); }
+};
+
+// runs a session against the terminal
+void runTerminalSession(Session& session) {
+    cout << session.start();
+    string line;
+    while (!session.isClosed() && getline(cin, line)) cout << session.feed(line);
+    cout << session.finish();
+}
+
+void Guest_option(User* guest, Order& order, vector<Reservation*>& reservations) {
+    GuestSession session(guest, order, reservations);
+    runTerminalSession(session);
+}
+
+void Admin_option(Staff& staff, vector<Order*>& orders, vector<Reservation*>& reservations) {
+    AdminSession session(staff, orders, reservations);
+    runTerminalSession(session);
+}
+
+// -------------------- Session Engine --------------------
+// Serves many sessions from one thread: every connection is a non-blocking
+// socket watched by epoll, input is split into lines and fed to the
+// connection's session, and replies are queued and written as the socket
+// accepts them. Sessions waiting on a payment are polled between events, and
+// keep being polled after their connection closes until the payment settles.
+class SessionEngine {
+private:
+    struct Connection {
+        int fd;
+        unique_ptr<Session> session;
+        string input;
+        string output;
+        bool want_write = false;
+    };
+
+    int epoll_fd;
+    int listen_fd = -1;
+    string listen_path;
+    unordered_map<int, Connection> connections;
+    set<int> pending;                        // connections whose session has work in flight
+    vector<unique_ptr<Session>> draining;    // closed sessions still waiting on a payment
+    function<unique_ptr<Session>()> make_session;
+    atomic<bool> stopping{false};
+
+    static const size_t MAX_LINE = 4096;
+
+    static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+    void updateEvents(Connection& c) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (c.want_write ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.fd = c.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    void closeConnection(int fd) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        if (it->second.session->hasPendingWork()) draining.push_back(move(it->second.session));
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        pending.erase(fd);
+        connections.erase(it);
+    }
+
+    // false if the connection was closed
+    bool flush(Connection& c) {
+        while (!c.output.empty()) {
+            ssize_t n = send(c.fd, c.output.data(), c.output.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                c.output.erase(0, n);
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                closeConnection(c.fd);
+                return false;
+            }
+        }
+        bool want_write = !c.output.empty();
+        if (want_write != c.want_write) {
+            c.want_write = want_write;
+            updateEvents(c);
+        }
+        if (!want_write && c.session->isClosed()) {
+            closeConnection(c.fd);
+            return false;
+        }
+        return true;
+    }
+
+    void onReadable(Connection& c) {
+        char buffer[4096];
+        bool eof = false;
+        while (true) {
+            ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) c.input.append(buffer, n);
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            else {
+                eof = true;
+                break;
+            }
+        }
+
+        size_t begin = 0, end;
+        while (!c.session->isClosed() && (end = c.input.find('\n', begin)) != string::npos) {
+            c.output += c.session->feed(string_view(c.input).substr(begin, end - begin));
+            begin = end + 1;
+            if (unique_ptr<Session> next = c.session->takeNext()) c.session = move(next);
+        }
+        c.input.erase(0, begin);
+        if (c.input.size() > MAX_LINE) eof = true;   // no newline in sight; drop the client
+
+        if (c.session->hasPendingWork()) pending.insert(c.fd);
+        int fd = c.fd;
+        if (flush(c) && eof) closeConnection(fd);
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) return;
+            attach(fd, make_session());
+        }
+    }
+
+    void pollPending() {
+        for (auto it = pending.begin(); it != pending.end();) {
+            Connection& c = connections[*it];
+            c.output += c.session->poll();
+            bool done = !c.session->hasPendingWork();
+            int fd = *it;
+            it = done ? pending.erase(it) : next(it);
+            flush(connections[fd]);
+        }
+        for (size_t i = 0; i < draining.size();) {
+            draining[i]->poll();
+            if (draining[i]->hasPendingWork()) i++;
+            else {
+                draining[i] = move(draining.back());
+                draining.pop_back();
+            }
+        }
+    }
+
+public:
+    SessionEngine(function<unique_ptr<Session>()> _make_session) : make_session(_make_session) {
+        epoll_fd = epoll_create1(0);
+        if (epoll_fd < 0) throw runtime_error("session engine: epoll_create1 failed");
+    }
+
+    ~SessionEngine() {
+        while (!connections.empty()) closeConnection(connections.begin()->first);
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(listen_path.c_str());
+        }
+        close(epoll_fd);
+        for (auto& session : draining) session->finish();
+    }
+
+    bool listenUnix(const string& path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        unlink(path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) return false;
+        if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 1024) < 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        listen_path = path;
+        setNonBlocking(listen_fd);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+        return true;
+    }
+
+    // takes ownership of a connected stream socket (for example one end of a socketpair)
+    void attach(int fd, unique_ptr<Session> session) {
+        setNonBlocking(fd);
+        Connection& c = connections[fd];
+        c.fd = fd;
+        c.session = move(session);
+        c.output = c.session->start();
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        flush(c);
+    }
+
+    void runOnce(int timeout_ms) {
+        epoll_event events[256];
+        if (!pending.empty() || !draining.empty()) timeout_ms = min(timeout_ms, 5);
+        int n = epoll_wait(epoll_fd, events, 256, timeout_ms);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                acceptClients();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            if (events[i].events & EPOLLOUT) {
+                if (!flush(it->second)) continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) onReadable(it->second);
+        }
+        pollPending();
+    }
+
+    void run() {
+        while (!stopping.load()) runOnce(50);
+    }
+
+    void stop() { stopping = true; }
+
+    size_t getSessionCount() { return connections.size(); }
+};
+
+// -------------------- Command Protocol --------------------
+// Compact line protocol for driving the ordering flow at volume:
+//   LOGIN <user> <password>          ADD <food id> [quantity]     COMBO <combo id>
+//   PAY CASH <amount> <currency>     PAY CARD <number>            PAY WALLET <name>
+//   RESERVE <date> <time> <party>    STATUS <order id> <0-3>      ORDER      QUIT
+// Every command gets one reply line, "OK ..." or "ERR <reason>". Card and
+// wallet payments reply "OK PENDING" and later push "EVENT PAID|FAILED <order>".
+// The parser only slices the line into string_views and never allocates;
+// replies are built in one buffer per session. Handling a command may still
+// allocate (a new order on LOGIN, payments, reservations, the returned reply).
+enum class CommandVerb { Invalid, Login, Add, Combo, Pay, Reserve, Status, Order, Quit };
+
+struct Command {
+    static const int MAX_ARGS = 4;
+    CommandVerb verb = CommandVerb::Invalid;
+    string_view args[MAX_ARGS];
+    int argc = 0;
+};
+
+bool parseCommand(string_view line, Command& cmd) {
+    static const pair<string_view, CommandVerb> VERBS[] = {
+        {"LOGIN", CommandVerb::Login}, {"ADD", CommandVerb::Add}, {"COMBO", CommandVerb::Combo},
+        {"PAY", CommandVerb::Pay}, {"RESERVE", CommandVerb::Reserve}, {"STATUS", CommandVerb::Status},
+        {"ORDER", CommandVerb::Order}, {"QUIT", CommandVerb::Quit}};
+
+    cmd.verb = CommandVerb::Invalid;
+    cmd.argc = 0;
+    size_t pos = 0;
+    bool first = true;
+    while (pos < line.size()) {
+        while (pos < line.size() && line[pos] == ' ') pos++;
+        if (pos == line.size()) break;
+        size_t end = line.find(' ', pos);
+        if (end == string_view::npos) end = line.size();
+        string_view token = line.substr(pos, end - pos);
+        pos = end;
+        if (first) {
+            for (auto& verb : VERBS) {
+                if (verb.first == token) cmd.verb = verb.second;
+            }
+            if (cmd.verb == CommandVerb::Invalid) return false;
+            first = false;
+        } else {
+            if (cmd.argc == Command::MAX_ARGS) return false;
+            cmd.args[cmd.argc++] = token;
+        }
+    }
+    return cmd.verb != CommandVerb::Invalid;
+}
+
+template <typename T>
+bool parseNumber(string_view text, T& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// YYYY-MM-DD, HH:MM and at least one guest
+bool validReservation(string_view date, string_view time_of_day, int party_size) {
+    auto digits = [](string_view text, size_t pos, size_t n, int low, int high) {
+        string_view field = text.substr(pos, n);
+        int value = 0;
+        return field.find_first_not_of("0123456789") == string_view::npos && parseNumber(field, value) && value >= low && value <= high;
+    };
+    return date.size() == 10 && date[4] == '-' && date[7] == '-' && digits(date, 0, 4, 1, 9999) && digits(date, 5, 2, 1, 12)
+           && digits(date, 8, 2, 1, 31) && time_of_day.size() == 5 && time_of_day[2] == ':' && digits(time_of_day, 0, 2, 0, 23)
+           && digits(time_of_day, 3, 2, 0, 59) && party_size >= 1;
+}
+
+// state shared by every protocol session of one server
+struct ProtocolContext {
+    AccountManager& accounts;
+    vector<Order*> orders;
+    unordered_map<string, Order*> order_index;
+    vector<Reservation*> reservations;
+
+    ProtocolContext(AccountManager& _accounts) : accounts(_accounts) {}
+};
+
+class ProtocolSession : public Session {
+private:
+    ProtocolContext& context;
+    User* user = nullptr;
+    Order* order = nullptr;
+    shared_future<PaymentResult> pending_auth;
+    PaymentMethod* pending_payment = nullptr;
+    string reply;   // reused between commands
+
+    void showMenu() override { out << "OK READY\n"; }
+    void handle(const string&) override {}
+
+    void ok(string_view detail = "") {
+        reply += "OK";
+        if (!detail.empty()) {
+            reply += ' ';
+            reply += detail;
+        }
+        reply += '\n';
+    }
+    void err(string_view reason) {
+        reply += "ERR ";
+        reply += reason;
+        reply += '\n';
+    }
+    void money(double amount) {
+        char buffer[32];
+        int n = snprintf(buffer, sizeof(buffer), "%.2f", amount);
+        reply.append(buffer, n);
+    }
+
+    void login(Command& cmd) {
+        if (cmd.argc != 2) return err("usage: LOGIN <user> <password>");
+        User* account = context.accounts.authenticate(string(cmd.args[0]), string(cmd.args[1]));
+        if (account == nullptr) return err("login failed");
+        user = account;
+        if (user->getRole() == "Staff") return ok("Staff");
+        order = orderSlab.make<Order>(user);
+        context.orders.push_back(order);
+        context.order_index[order->getOrderId()] = order;
+        reply += "OK Guest ";
+        reply += order->getOrderId();
+        reply += '\n';
+    }
+
+    // the payment covers the total, so items are fixed once paying starts
+    bool canChangeItems() {
+        if (order->isPaid()) err("already paid");
+        else if (pending_payment != nullptr) err("payment in progress");
+        else return true;
+        return false;
+    }
+
+    void add(Command& cmd) {
+        int quantity = 1;
+        if (cmd.argc < 1 || (cmd.argc == 2 && !parseNumber(cmd.args[1], quantity)) || quantity < 1) {
+            return err("usage: ADD <food id> [quantity]");
+        }
+        if (!canChangeItems()) return;
+        FoodRef food = findFoodById(cmd.args[0]);
+        if (!food || !menuAvailability.isFoodVisible(food->getId())) return err("unknown food");
+        if (!order->addFood(food.get(), quantity)) return err("sold out");
+        reply += "OK ";
+        money(order->getTotalPrice());
+        reply += '\n';
+    }
+
+    void combo(Command& cmd) {
+        if (cmd.argc != 1) return err("usage: COMBO <combo id>");
+        if (!canChangeItems()) return;
+        Combo* found = comboManager.findComboById(cmd.args[0]);
+        if (found == nullptr || !menuAvailability.isComboVisible(found->getComboId())) return err("unknown combo");
+        if (!order->addCombo(*found)) return err("sold out");
+        reply += "OK ";
+        money(order->getTotalPrice());
+        reply += '\n';
+    }
+
+    void startAuthorization(PaymentMethod* payment) {
+        PaymentSubmission sub = authorizePayment(*order, payment);
+        if (sub.invalid || sub.duplicate) {
+            paymentSlab.destroy(payment);
+            return err(sub.invalid ? "invalid card number" : "already submitted");
+        }
+        order->setPaymentMethod(payment);
+        pending_auth = sub.result;
+        pending_payment = payment;
+        ok("PENDING");
+    }
+
+    void pay(Command& cmd) {
+        if (order->isPaid()) return err("already paid");
+        if (pending_payment != nullptr) return err("payment in progress");
+        if (cmd.argc == 3 && cmd.args[0] == "CASH") {
+            double cash = 0.0;
+            if (!parseNumber(cmd.args[1], cash)) return err("bad amount");
+            if (cash < order->getTotalPrice()) return err("not enough cash");
+            if (acceptCashPayment(*order).duplicate) return err("already recorded");
+            PaymentMethod* payment = paymentSlab.make<CashPayment>(cash, string(cmd.args[2]));
+            order->markPaid(payment);
+            paymentManager.addPayment(payment, order->getOrderId(), order->getTotalPrice());
+            reply += "OK CHANGE ";
+            money(cash - order->getTotalPrice());
+            reply += '\n';
+        } else if (cmd.argc == 2 && cmd.args[0] == "CARD") {
+            if (cmd.args[1].size() != 16) return err("invalid card number");
+            startAuthorization(paymentSlab.make<CreditPayment>(order->getTotalPrice(), string(cmd.args[1])));
+        } else if (cmd.argc == 2 && cmd.args[0] == "WALLET") {
+            startAuthorization(paymentSlab.make<eWalletPayment>(order->getTotalPrice(), string(cmd.args[1])));
+        } else {
+            err("usage: PAY CASH <amount> <currency> | PAY CARD <number> | PAY WALLET <name>");
+        }
+    }
+
+    void reserve(Command& cmd) {
+        int party_size = 0;
+        if (cmd.argc != 3 || !parseNumber(cmd.args[2], party_size)) return err("usage: RESERVE <date> <time> <party>");
+        if (!validReservation(cmd.args[0], cmd.args[1], party_size)) return err("bad date, time or party size");
+        Reservation* reservation = reservationSlab.make<Reservation>(user, string(cmd.args[0]), string(cmd.args[1]), party_size);
+        context.reservations.push_back(reservation);
+        ok(reservation->getReservationID());
+    }
+
+    void status(Command& cmd) {
+        int code = -1;
+        if (cmd.argc != 2 || !parseNumber(cmd.args[1], code) || code < 0 || code > 3) {
+            return err("usage: STATUS <order id> <0-3>");
+        }
+        auto it = context.order_index.find(string(cmd.args[0]));
+        if (it == context.order_index.end()) return err("unknown order");
+        int before = (int)it->second->getStatus();
+        if (!it->second->setStatus(static_cast<OrderStatus>(code))) return err("order is closed");
+        auditLog.record(user->getUsername(), AuditAction::OrderStatus, it->first, before, code);
+        ok();
+    }
+
+    void describeOrder() {
+        reply += "OK ";
+        reply += order->getOrderId();
+        reply += ' ';
+        char count[24];
+        reply.append(count, to_chars(count, count + sizeof(count), order->getLineCount()).ptr);
+        reply += ' ';
+        money(order->getTotalPrice());
+        reply += order->isPaid() ? " PAID\n" : " UNPAID\n";
+    }
+
+    void run(Command& cmd) {
+        bool is_guest = order != nullptr;
+        bool is_staff = user != nullptr && !is_guest;
+        switch (cmd.verb) {
+            case CommandVerb::Login:
+                if (user != nullptr) return err("already logged in");
+                return login(cmd);
+            case CommandVerb::Quit:
+                closed = true;
+                return ok("BYE");
+            case CommandVerb::Status:
+                if (!is_staff) return err("staff only");
+                if (!staffCan(user, PERM_UPDATE_ORDER)) return err("permission denied");
+                return status(cmd);
+            default:
+                break;
+        }
+        if (!is_guest) return err("guest login required");
+        switch (cmd.verb) {
+            case CommandVerb::Add: return add(cmd);
+            case CommandVerb::Combo: return combo(cmd);
+            case CommandVerb::Pay: return pay(cmd);
+            case CommandVerb::Reserve: return reserve(cmd);
+            case CommandVerb::Order: return describeOrder();
+            default: return err("unknown command");
+        }
+    }
+
+    void settlePayment() {
+        if (pending_payment == nullptr || pending_auth.wait_for(chrono::seconds(0)) != future_status::ready) return;
+        PaymentResult result = pending_auth.get();
+        capture([&] { applyPaymentResult(*order, pending_payment, result, out); });
+        pending_payment = nullptr;
+        reply += result.status == PaymentStatus::Approved ? "EVENT PAID " : "EVENT FAILED ";
+        reply += order->getOrderId();
+        reply += '\n';
+    }
+
+public:
+    ProtocolSession(ProtocolContext& _context) : context(_context) { reply.reserve(256); }
+
+    string feed(string_view line) override {
+        reply.clear();
+        Command cmd;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!parseCommand(line, cmd)) err("unknown command");
+        else run(cmd);
+        settlePayment();
+        return reply;
+    }
+
+    string poll() override {
+        reply.clear();
+        settlePayment();
+        return reply;
+    }
+    bool hasPendingWork() override { return pending_payment != nullptr; }
+    string finish() override {
+        if (pending_payment != nullptr) capture([&] { applyPaymentResult(*order, pending_payment, pending_auth.get(), out); });
+        pending_payment = nullptr;
+        return "";
+    }
+};
+
+// -------------------- Load Generator --------------------
+// Replays a scripted guest session over many socket connections to a session
+// engine and times every command from send to reply.
+struct LoadReport {
+    size_t sessions = 0;
+    size_t commands = 0;
+    size_t errors = 0;
+    double seconds = 0.0;
+    double p50_us = 0.0;
+    double p90_us = 0.0;
+    double p99_us = 0.0;
+    double max_us = 0.0;
+    string unit = "commands";
+
+    // sorts the samples and fills in the percentiles
+    void summarize(vector<double>& latencies_us) {
+        sort(latencies_us.begin(), latencies_us.end());
+        commands = latencies_us.size();
+        if (latencies_us.empty()) return;
+        p50_us = latencies_us[latencies_us.size() / 2];
+        p90_us = latencies_us[latencies_us.size() * 9 / 10];
+        p99_us = latencies_us[latencies_us.size() * 99 / 100];
+        max_us = latencies_us.back();
+    }
+
+    void display() {
+        cout << "=== Load Test ===" << endl;
+        cout << sessions << " sessions, " << commands << " " << unit << " (" << errors << " errors) in "
+             << fixed << setprecision(2) << seconds << " s" << endl;
+        cout << setprecision(0) << commands / seconds << " " << unit << "/sec" << endl;
+        cout << setprecision(1) << "latency p50 " << p50_us << " us, p90 " << p90_us << " us, p99 " << p99_us
+             << " us, max " << max_us << " us" << endl;
+        cout << "=================" << endl;
+    }
+};
+
+class LoadGenerator {
+private:
+    struct Client {
+        int fd;
+        string buffer;
+    };
+
+    // blocks until a reply line arrives; pushed EVENT lines are skipped
+    static bool readReply(Client& client, string& line) {
+        char chunk[4096];
+        while (true) {
+            size_t end = client.buffer.find('\n');
+            if (end != string::npos) {
+                line = client.buffer.substr(0, end);
+                client.buffer.erase(0, end + 1);
+                if (line.compare(0, 6, "EVENT ") == 0) continue;
+                return true;
+            }
+            ssize_t n = recv(client.fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            client.buffer.append(chunk, n);
+        }
+    }
+
+public:
+    // script lines are sent in order by every session; clients are spread over threads
+    LoadReport run(function<unique_ptr<Session>()> make_session, int sessions, int threads, const vector<string>& script) {
+        SessionEngine engine(make_session);
+        vector<Client> clients(sessions);
+        for (Client& client : clients) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) throw runtime_error("load generator: socketpair failed");
+            engine.attach(pair[0], make_session());
+            client.fd = pair[1];
+        }
+        thread loop([&]() { engine.run(); });
+
+        vector<vector<double>> latencies(threads);
+        vector<size_t> errors(threads, 0);
+        auto start = chrono::steady_clock::now();
+        runWorkers(threads, [&](unsigned t) {
+            vector<Client*> mine;
+            for (size_t i = t; i < clients.size(); i += threads) mine.push_back(&clients[i]);
+            vector<chrono::steady_clock::time_point> sent(mine.size());
+            string line;
+            for (Client* client : mine) readReply(*client, line);   // greeting
+            for (const string& command : script) {
+                string wire = command + "\n";
+                for (size_t i = 0; i < mine.size(); i++) {
+                    sent[i] = chrono::steady_clock::now();
+                    send(mine[i]->fd, wire.data(), wire.size(), MSG_NOSIGNAL);
+                }
+                for (size_t i = 0; i < mine.size(); i++) {
+                    if (!readReply(*mine[i], line) || line.compare(0, 2, "OK") != 0) errors[t]++;
+                    latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent[i]).count());
+                }
+            }
+        });
+        LoadReport report;
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        engine.stop();
+        loop.join();
+        for (Client& client : clients) close(client.fd);
+
+        vector<double> all;
+        for (size_t t = 0; t < latencies.size(); t++) {
+            all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+            report.errors += errors[t];
+        }
+        report.sessions = sessions;
+        report.summarize(all);
+        return report;
+    }
+};
+
+// -------------------- HTTP Server --------------------
+// Small HTTP/1.1 server for kiosks and delivery tablets. Each worker thread
+// runs its own epoll loop; the listening socket is shared with EPOLLEXCLUSIVE
+// so an incoming connection wakes one worker, which then owns it for its whole
+// keep-alive lifetime. Requests are parsed in place and handed to the handler
+// as views into the connection buffer.
+struct HttpRequest {
+    string_view method;
+    string_view path;
+    string_view query;
+    string_view body;
+    bool keep_alive = true;
+
+    // a field from the query string or a form-encoded body, "" if missing
+    string param(string_view key) const {
+        for (string_view source : {query, body}) {
+            size_t pos = 0;
+            while (pos <= source.size()) {
+                size_t end = source.find('&', pos);
+                if (end == string_view::npos) end = source.size();
+                string_view pair = source.substr(pos, end - pos);
+                size_t eq = pair.find('=');
+                if (eq != string_view::npos && pair.substr(0, eq) == key) return decode(pair.substr(eq + 1));
+                pos = end + 1;
+            }
+        }
+        return "";
+    }
+
+    static string decode(string_view text) {
+        string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '+') out += ' ';
+            else if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char)text[i + 1])
+                     && isxdigit((unsigned char)text[i + 2])) {
+                int value = 0;
+                from_chars(text.data() + i + 1, text.data() + i + 3, value, 16);
+                out += (char)value;
+                i += 2;
+            } else out += text[i];   // a stray '%' is kept as typed
+        }
+        return out;
+    }
+};
+
+struct HttpResponse {
+    int status = 200;
+    string body;
+    shared_ptr<const string> shared_body;   // used instead of body when set, so cached payloads are not copied
+    const char* content_type = "application/json";
+
+    void error(int code, string_view message) {
+        status = code;
+        body = "{\"error\":\"";
+        body += message;
+        body += "\"}";
+    }
+};
+
+class HttpServer {
+public:
+    using Handler = function<void(const HttpRequest&, HttpResponse&)>;
+
+private:
+    struct Connection {
+        int fd;
+        string input;
+        string output;
+        bool want_write = false;
+        bool closing = false;   // close once the output is written
+    };
+
+    struct Worker {
+        int epoll_fd = -1;
+        unordered_map<int, Connection> connections;
+        thread runner;
+    };
+
+    static const size_t MAX_HEADER = 8192;
+    static const size_t MAX_BODY = 65536;
+
+    Handler handler;
+    int listen_fd = -1;
+    int port = 0;
+    vector<unique_ptr<Worker>> workers;
+    atomic<bool> stopping{false};
+    atomic<long> served{0};
+
+    static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+    static const char* reason(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 201: return "Created";
+            case 202: return "Accepted";
+            case 400: return "Bad Request";
+            case 401: return "Unauthorized";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 409: return "Conflict";
+            case 413: return "Payload Too Large";
+            case 501: return "Not Implemented";
+            default: return "Internal Server Error";
+        }
+    }
+
+    static void writeResponse(Connection& c, const HttpResponse& response, bool keep_alive) {
+        const string& body = response.shared_body ? *response.shared_body : response.body;
+        char header[256];
+        int n = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                         response.status, reason(response.status), response.content_type, body.size(),
+                         keep_alive ? "" : "Connection: close\r\n");
+        c.output.append(header, n);
+        c.output += body;
+        if (!keep_alive) c.closing = true;
+    }
+
+    static bool headerIs(string_view line, string_view name) {
+        if (line.size() <= name.size() || line[name.size()] != ':') return false;
+        for (size_t i = 0; i < name.size(); i++) {
+            if (tolower(line[i]) != tolower(name[i])) return false;
+        }
+        return true;
+    }
+
+    static string_view headerValue(string_view line, size_t name_size) {
+        string_view value = line.substr(name_size + 1);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        return value;
+    }
+
+    // 0 = need more bytes, -1 = malformed, otherwise the request's length in the buffer
+    static long parseRequest(string_view data, HttpRequest& request, int& error) {
+        size_t header_end = data.find("\r\n\r\n");
+        if (header_end == string_view::npos) {
+            if (data.size() > MAX_HEADER) error = 413;
+            return data.size() > MAX_HEADER ? -1 : 0;
+        }
+        string_view head = data.substr(0, header_end);
+        size_t line_end = head.find("\r\n");
+        string_view request_line = head.substr(0, line_end);
+        size_t sp1 = request_line.find(' ');
+        size_t sp2 = request_line.rfind(' ');
+        if (sp1 == string_view::npos || sp2 == sp1) {
+            error = 400;
+            return -1;
+        }
+        request.method = request_line.substr(0, sp1);
+        string_view target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+        string_view version = request_line.substr(sp2 + 1);
+        size_t question = target.find('?');
+        request.path = target.substr(0, question);
+        request.query = question == string_view::npos ? string_view() : target.substr(question + 1);
+        request.keep_alive = version == "HTTP/1.1";
+
+        size_t content_length = 0;
+        size_t pos = line_end == string_view::npos ? head.size() : line_end + 2;
+        while (pos < head.size()) {
+            size_t end = head.find("\r\n", pos);
+            if (end == string_view::npos) end = head.size();
+            string_view line = head.substr(pos, end - pos);
+            if (headerIs(line, "Content-Length")) {
+                string_view value = headerValue(line, 14);
+                if (!parseNumber(value, content_length)) {
+                    error = 400;
+                    return -1;
+                }
+            } else if (headerIs(line, "Transfer-Encoding")) {
+                error = 501;   // only Content-Length bodies are supported
+                return -1;
+            } else if (headerIs(line, "Connection")) {
+                string_view value = headerValue(line, 10);
+                if (value == "close") request.keep_alive = false;
+                else if (value == "keep-alive") request.keep_alive = true;
+            }
+            pos = end + 2;
+        }
+        if (content_length > MAX_BODY) {
+            error = 413;
+            return -1;
+        }
+        size_t total = header_end + 4 + content_length;
+        if (data.size() < total) return 0;
+        request.body = data.substr(header_end + 4, content_length);
+        return total;
+    }
+
+    void updateEvents(Worker& w, Connection& c) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (c.want_write ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.fd = c.fd;
+        epoll_ctl(w.epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    void closeConnection(Worker& w, int fd) {
+        epoll_ctl(w.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        w.connections.erase(fd);
+    }
+
+    // false if the connection was closed
+    bool flush(Worker& w, Connection& c) {
+        size_t written = 0;
+        while (written < c.output.size()) {
+            ssize_t n = send(c.fd, c.output.data() + written, c.output.size() - written, MSG_NOSIGNAL);
+            if (n > 0) written += n;
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            else {
+                closeConnection(w, c.fd);
+                return false;
+            }
+        }
+        c.output.erase(0, written);
+        bool want_write = !c.output.empty();
+        if (want_write != c.want_write) {
+            c.want_write = want_write;
+            updateEvents(w, c);
+        }
+        if (!want_write && c.closing) {
+            closeConnection(w, c.fd);
+            return false;
+        }
+        return true;
+    }
+
+    void onReadable(Worker& w, Connection& c) {
+        char buffer[16384];
+        bool eof = false;
+        while (true) {
+            ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) c.input.append(buffer, n);
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            else {
+                eof = true;
+                break;
+            }
+        }
+
+        // pipelined requests are answered in order
+        size_t begin = 0;
+        while (!c.closing && begin < c.input.size()) {
+            HttpRequest request;
+            int error = 0;
+            long used = parseRequest(string_view(c.input).substr(begin), request, error);
+            if (used == 0) break;
+            HttpResponse response;
+            if (used < 0) {
+                response.error(error, reason(error));
+                writeResponse(c, response, false);
+                break;
+            }
+            handler(request, response);
+            writeResponse(c, response, request.keep_alive);
+            served++;
+            begin += used;
+        }
+        c.input.erase(0, begin);
+
+        int fd = c.fd;
+        if (flush(w, c) && eof) closeConnection(w, fd);
+    }
+
+    void acceptClients(Worker& w) {
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0) return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Connection& c = w.connections[fd];
+            c.fd = fd;
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(w.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void runWorker(Worker& w) {
+        epoll_event events[256];
+        while (!stopping.load()) {
+            int n = epoll_wait(w.epoll_fd, events, 256, 50);
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd) {
+                    acceptClients(w);
+                    continue;
+                }
+                auto it = w.connections.find(fd);
+                if (it == w.connections.end()) continue;
+                if (events[i].events & EPOLLOUT) {
+                    if (!flush(w, it->second)) continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) onReadable(w, it->second);
+            }
+        }
+    }
+
+public:
+    HttpServer(Handler _handler) : handler(_handler) {}
+
+    ~HttpServer() {
+        stop();
+        if (listen_fd >= 0) close(listen_fd);
+    }
+
+    // binds to 127.0.0.1; port 0 picks a free port, see getPort()
+    bool listenLoopback(int requested_port) {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listen_fd < 0) return false;
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(requested_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 4096) < 0
+            || getsockname(listen_fd, (sockaddr*)&addr, &len) < 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        return true;
+    }
+
+    void start(unsigned worker_count) {
+        for (unsigned i = 0; i < max(1u, worker_count); i++) {
+            unique_ptr<Worker> w(new Worker());
+            w->epoll_fd = epoll_create1(0);
+            if (w->epoll_fd < 0) throw runtime_error("http server: epoll_create1 failed");
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.fd = listen_fd;
+            epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+            workers.push_back(move(w));
+        }
+        for (auto& w : workers) {
+            Worker* worker = w.get();
+            worker->runner = thread([this, worker]() { runWorker(*worker); });
+        }
+    }
+
+    void stop() {
+        stopping = true;
+        for (auto& w : workers) {
+            if (w->runner.joinable()) w->runner.join();
+            while (!w->connections.empty()) closeConnection(*w, w->connections.begin()->first);
+            close(w->epoll_fd);
+        }
+        workers.clear();
+    }
+
+    int getPort() { return port; }
+    long getServedCount() { return served.load(); }
+};
+
+// -------------------- HTTP API --------------------
+//   GET  /menu                            cached menu JSON
+//   GET  /search             q[, type, vegetarian=1, max_price, limit]
+//   POST /orders             user, password
+//   GET  /orders/<id>
+//   POST /orders/<id>/items  food[, quantity] | combo
+//   POST /orders/<id>/payment method=cash, amount, currency | method=card, number | method=wallet, name
+//   POST /reservations       user, password, date, time, party
+// Parameters come from the query string or a form-encoded body. Paid and
+// cancelled orders stay readable until keep_closed newer ones have closed,
+// then they are dropped and answer 404.
+class HttpApi {
+private:
+    // one lock per order, so different orders are served in parallel. Workers
+    // never touch the global notifier, which is not thread-safe: each order
+    // notifies its own, under the entry's lock.
+    struct OrderEntry {
+        mutex lock;
+        NotificationManager notifications;
+        Order* order = nullptr;
+        PaymentMethod* pending_payment = nullptr;
+        shared_future<PaymentResult> pending_auth;
+        bool closed = false;   // counted in closed_ids
+
+        ~OrderEntry() {
+            settlePayment(*this, true);
+            orderSlab.destroy(order);
+        }
+    };
+
+    AccountManager& accounts;
+    mutex accounts_lock;
+    mutex orders_lock;
+    // shared so a worker still serving an entry keeps it alive after it is dropped
+    unordered_map<string, shared_ptr<OrderEntry>> orders;
+    deque<string> closed_ids;   // oldest first, guarded by orders_lock
+    size_t keep_closed;
+    mutex reservations_lock;
+    NotificationManager reservation_notifications;   // guarded by reservations_lock
+    vector<Reservation*> reservations;
+
+    User* authenticate(const HttpRequest& request) {
+        lock_guard<mutex> lock(accounts_lock);
+        return accounts.authenticate(request.param("user"), request.param("password"));
+    }
+
+    shared_ptr<OrderEntry> findOrder(string_view id) {
+        lock_guard<mutex> lock(orders_lock);
+        auto it = orders.find(string(id));
+        return it == orders.end() ? nullptr : it->second;
+    }
+
+    void retireClosed(const string& id) {
+        vector<shared_ptr<OrderEntry>> dropped;   // destroyed after the lock is released
+        lock_guard<mutex> lock(orders_lock);
+        closed_ids.push_back(id);
+        while (closed_ids.size() > keep_closed) {
+            auto it = orders.find(closed_ids.front());
+            if (it != orders.end()) {
+                dropped.push_back(move(it->second));
+                orders.erase(it);
+            }
+            closed_ids.pop_front();
+        }
+    }
+
+    // caller holds the entry's lock; the result is reported in the order's JSON,
+    // so the console message is dropped
+    static void settlePayment(OrderEntry& entry, bool wait) {
+        if (entry.pending_payment == nullptr) return;
+        if (!wait && entry.pending_auth.wait_for(chrono::seconds(0)) != future_status::ready) return;
+        stringstream ignored;
+        applyPaymentResult(*entry.order, entry.pending_payment, entry.pending_auth.get(), ignored);
+        entry.pending_payment = nullptr;
+    }
+
+    static string orderJson(OrderEntry& entry) {
+        Order* order = entry.order;
+        string json = "{\"id\":\"" + order->getOrderId() + "\",\"items\":[";
+        vector<Food*> foods = order->getFoodItems();
+        for (size_t i = 0; i < foods.size(); i++) {
+            if (i > 0) json += ',';
+            json += "\"" + jsonEscape(foods[i]->getId()) + "\"";
+        }
+        json += "],\"combos\":[";
+        vector<Combo> combos = order->getCombos();
+        for (size_t i = 0; i < combos.size(); i++) {
+            if (i > 0) json += ',';
+            json += "\"" + jsonEscape(combos[i].getComboId()) + "\"";
+        }
+        json += "],\"total\":" + jsonMoney(order->getTotalPrice()) + ",\"payment\":\"";
+        json += order->isPaid() ? "paid" : entry.pending_payment != nullptr ? "pending" : "unpaid";
+        json += "\"}";
+        return json;
+    }
+
+    void createOrder(const HttpRequest& request, HttpResponse& response) {
+        User* user = authenticate(request);
+        if (user == nullptr) return response.error(401, "login failed");
+        if (user->getRole() != "Guest") return response.error(400, "only guests place orders");
+        shared_ptr<OrderEntry> entry = make_shared<OrderEntry>();
+        entry->order = orderSlab.make<Order>(user, entry->notifications);
+        response.status = 201;
+        response.body = orderJson(*entry);
+        lock_guard<mutex> lock(orders_lock);
+        orders[entry->order->getOrderId()] = move(entry);
+    }
+
+    void addItems(OrderEntry& entry, const HttpRequest& request, HttpResponse& response) {
+        Order* order = entry.order;
+        if (order->isPaid() || entry.pending_payment != nullptr) return response.error(409, "order already paid");
+        string food_id = request.param("food");
+        string combo_id = request.param("combo");
+        if (!food_id.empty()) {
+            int quantity = 1;
+            string text = request.param("quantity");
+            if (!text.empty() && (!parseNumber(text, quantity) || quantity < 1)) return response.error(400, "bad quantity");
+            FoodRef food = findFoodById(food_id);
+            if (!food || !menuAvailability.isFoodVisible(food_id)) return response.error(404, "unknown food");
+            if (!order->addFood(food.get(), quantity)) return response.error(409, "sold out");
+        } else if (!combo_id.empty()) {
+            Combo* combo = comboManager.findComboById(combo_id);
+            if (combo == nullptr || !menuAvailability.isComboVisible(combo_id)) return response.error(404, "unknown combo");
+            if (!order->addCombo(*combo)) return response.error(409, "sold out");
+        } else {
+            return response.error(400, "food or combo required");
+        }
+        response.body = orderJson(entry);
+    }
+
+    void pay(OrderEntry& entry, const HttpRequest& request, HttpResponse& response) {
+        Order* order = entry.order;
+        if (order->isPaid()) return response.error(409, "already paid");
+        if (entry.pending_payment != nullptr) return response.error(409, "payment in progress");
+        string method = request.param("method");
+        PaymentMethod* payment = nullptr;
+        if (method == "cash") {
+            double cash = 0.0;
+            if (!parseNumber(request.param("amount"), cash)) return response.error(400, "bad amount");
+            if (cash < order->getTotalPrice()) return response.error(400, "not enough cash");
+            if (acceptCashPayment(*order).duplicate) return response.error(409, "already recorded");
+            payment = paymentSlab.make<CashPayment>(cash, request.param("currency"));
+            order->markPaid(payment);
+            paymentManager.addPayment(payment, order->getOrderId(), order->getTotalPrice());
+            response.body = "{\"status\":\"paid\",\"change\":" + jsonMoney(cash - order->getTotalPrice()) + "}";
+            return;
+        }
+        if (method == "card") {
+            string number = request.param("number");
+            if (number.size() != 16) return response.error(400, "invalid card number");
+            payment = paymentSlab.make<CreditPayment>(order->getTotalPrice(), number);
+        } else if (method == "wallet") {
+            payment = paymentSlab.make<eWalletPayment>(order->getTotalPrice(), request.param("name"));
+        } else {
+            return response.error(400, "unknown payment method");
         }
-        delete staffAccount;
+        PaymentSubmission sub = authorizePayment(*order, payment);
+        if (sub.invalid || sub.duplicate) {
+            paymentSlab.destroy(payment);
+            if (sub.invalid) return response.error(400, "invalid card number");
+            return response.error(409, "already submitted");
+        }
+        order->setPaymentMethod(payment);
+        entry.pending_payment = payment;
+        entry.pending_auth = sub.result;
+        response.status = 202;
+        response.body = "{\"status\":\"pending\"}";
     }
 
-    // Đăng ký Guest
-    bool registerGuest(string username, string password){
-        if(guests.find(username) != guests.end()) return false; // đã tồn tại
-        guests[username] = new Guest(username, password);
-        return true;
+    void routeOrder(string_view rest, const HttpRequest& request, HttpResponse& response) {
+        size_t slash = rest.find('/');
+        shared_ptr<OrderEntry> entry = findOrder(rest.substr(0, slash));
+        if (entry == nullptr) return response.error(404, "unknown order");
+        string_view action = slash == string_view::npos ? string_view() : rest.substr(slash + 1);
+        bool just_closed = false;
+        {
+            lock_guard<mutex> lock(entry->lock);
+            settlePayment(*entry, false);
+            if (action.empty()) {
+                if (request.method != "GET") response.error(405, "use GET");
+                else response.body = orderJson(*entry);
+            } else if (action == "items" || action == "payment") {
+                if (request.method != "POST") response.error(405, "use POST");
+                else if (action == "items") addItems(*entry, request, response);
+                else pay(*entry, request, response);
+            } else {
+                response.error(404, "not found");
+            }
+            OrderStatus status = entry->order->getStatus();
+            if (!entry->closed && entry->pending_payment == nullptr
+                && (entry->order->isPaid() || status == OrderStatus::Cancelled)) {
+                entry->closed = just_closed = true;
+            }
+        }
+        if (just_closed) retireClosed(entry->order->getOrderId());
     }
 
-    // Đăng nhập Guest hoặc Staff
-    bool login(string username, string password){
-        if(username == staffAccount->getUsername()){ 
-            return staffAccount->login(username, password);
+    static void search(const HttpRequest& request, HttpResponse& response) {
+        SearchQuery query;
+        query.text = request.param("q");
+        query.type = request.param("type");
+        query.vegetarian_only = request.param("vegetarian") == "1";
+        string max_price = request.param("max_price"), limit = request.param("limit");
+        if ((!max_price.empty() && !parseNumber(max_price, query.max_price))
+            || (!limit.empty() && !parseNumber(limit, query.limit))) {
+            return response.error(400, "bad filter");
         }
-        auto it = guests.find(username);
-        if(it != guests.end()){
-            return it->second->login(username, password);
+        string json = "{\"results\":[";
+        vector<SearchHit> hits = menuSearch.search(query);
+        for (size_t i = 0; i < hits.size(); i++) {
+            if (i > 0) json += ',';
+            json += "{\"id\":\"" + jsonEscape(hits[i].id) + "\",\"name\":\"" + jsonEscape(hits[i].name) + "\",\"type\":\""
+                    + hits[i].type + "\",\"price\":" + jsonMoney(hits[i].price) + ",\"distance\":" + to_string(hits[i].distance) + "}";
         }
-        return false;
+        json += "]}";
+        response.body = move(json);
     }
 
-    void displayAllAccounts(){
-        cout << "Staff Account (dev cấp): " 
-             << staffAccount->getUsername() << endl;
-
-        cout << "Guest Accounts:\n";
-        int i = 1;
-        for(auto &p : guests){
-            cout << "\t#" << i++ << ". " 
-                 << p.second->getUsername() 
-                 << " (" << p.second->getRole() << ")"
-                 << " [ID: " << p.second->getId() << "]"
-                 << endl;
+    void createReservation(const HttpRequest& request, HttpResponse& response) {
+        User* user = authenticate(request);
+        if (user == nullptr) return response.error(401, "login failed");
+        int party_size = 0;
+        string date = request.param("date"), time_of_day = request.param("time");
+        if (!parseNumber(request.param("party"), party_size) || !validReservation(date, time_of_day, party_size)) {
+            return response.error(400, "date (YYYY-MM-DD), time (HH:MM) and party required");
         }
+        Reservation* reservation;
+        {
+            lock_guard<mutex> lock(reservations_lock);
+            reservation = reservationSlab.make<Reservation>(user, date, time_of_day, party_size, reservation_notifications);
+            reservations.push_back(reservation);
+        }
+        response.status = 201;
+        response.body = "{\"id\":\"" + reservation->getReservationID() + "\",\"status\":\"" + reservation->getStatus() + "\"}";
     }
-};
-
-class PaymentMethod {
-protected:
-    string method_name;
-    double amount;
 
 public:
-    PaymentMethod(string _method_name, double _amount)
-        : method_name(_method_name), amount(_amount) {
-        stringstream ss;
-    }
+    HttpApi(AccountManager& _accounts, size_t _keep_closed = 1024) : accounts(_accounts), keep_closed(_keep_closed) {}
 
-    virtual void display() {}
+    ~HttpApi() {
+        orders.clear();
+        for (Reservation* reservation : reservations) reservationSlab.destroy(reservation);
+    }
 
-    string getMethodName() { return method_name; }
-    double getAmount() { return amount; }
+    void handle(const HttpRequest& request, HttpResponse& response) {
+        string_view path = request.path;
+        if (path == "/menu") {
+            if (request.method != "GET") return response.error(405, "use GET");
+            response.shared_body = menuCache.json();
+        } else if (path == "/search") {
+            if (request.method != "GET") return response.error(405, "use GET");
+            search(request, response);
+        } else if (path == "/orders") {
+            if (request.method != "POST") return response.error(405, "use POST");
+            createOrder(request, response);
+        } else if (path.compare(0, 8, "/orders/") == 0) {
+            routeOrder(path.substr(8), request, response);
+        } else if (path == "/reservations") {
+            if (request.method != "POST") return response.error(405, "use POST");
+            createReservation(request, response);
+        } else if (path == "/metrics") {
+            if (request.method != "GET") return response.error(405, "use GET");
+            stringstream exposition;
+            metrics.writePrometheus(exposition);
+            response.body = exposition.str();
+            response.content_type = "text/plain; version=0.0.4";
+        } else {
+            response.error(404, "not found");
+        }
+    }
 
-    virtual ~PaymentMethod() {}
+    size_t getOrderCount() {
+        lock_guard<mutex> lock(orders_lock);
+        return orders.size();
+    }
 };
 
-class CashPayment : public PaymentMethod{
+// -------------------- HTTP Benchmark --------------------
+// Keep-alive client: every connection sends one request, waits for the whole
+// response and sends the next, so the numbers are closed-loop throughput.
+class HttpBenchmark {
 private:
-    string currency;    //VND, Euro,...
-public:
-    CashPayment(double _amount, string _cur) : PaymentMethod("Cash", _amount){
-        currency = _cur;
+    // reads one response off the socket; false on a broken connection or non-2xx status
+    static bool readResponse(int fd, string& buffer) {
+        char chunk[16384];
+        while (true) {
+            size_t header_end = buffer.find("\r\n\r\n");
+            if (header_end != string::npos) {
+                size_t length_at = buffer.find("Content-Length: ");
+                size_t length = 0;
+                if (length_at == string::npos || length_at > header_end) return false;
+                length = strtoul(buffer.c_str() + length_at + 16, nullptr, 10);
+                if (buffer.size() >= header_end + 4 + length) {
+                    bool ok = buffer.compare(9, 1, "2") == 0;
+                    buffer.erase(0, header_end + 4 + length);
+                    return ok;
+                }
+            }
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+        }
     }
-    string getCurrency(){return currency;}
-    void setCurrency(string _cur){currency = _cur;}
 
-    void display() override{
-        cout << "Payment via Cash" << endl;
-        cout << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
-        cout << "Currency: " << getCurrency() << endl;
-        cout << "====================" << endl;
+    static int connectLoopback(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
     }
-};
 
-class CreditPayment : public PaymentMethod{
-private:
-    string card_number;
 public:
-    CreditPayment(double _amount, string _card_number) : PaymentMethod("Credit", _amount){
-        card_number = _card_number;
-    }
-    string getCardNumber(){return card_number;}
-    void setCardNumber(string _card){card_number = _card;}
-    void display() override {
-    cout << "Payment via Credit Card" << endl;
-    cout << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
-    if (card_number.size() >= 4)
-        cout << "Card Number: ****" << card_number.substr(card_number.size() - 4) << endl;
-    else
-        cout << "Card Number: (invalid)" << endl;
-    cout << "====================" << endl;
+    LoadReport run(int port, const string& request, int connections, int threads, int requests_per_connection) {
+        vector<vector<double>> latencies(threads);
+        vector<size_t> errors(threads, 0);
+        auto start = chrono::steady_clock::now();
+        runWorkers(threads, [&](unsigned t) {
+            vector<int> fds;
+            vector<string> buffers;
+            for (int i = t; i < connections; i += threads) {
+                int fd = connectLoopback(port);
+                if (fd < 0) errors[t]++;
+                else fds.push_back(fd);
+            }
+            buffers.resize(fds.size());
+            vector<chrono::steady_clock::time_point> sent(fds.size());
+            for (int r = 0; r < requests_per_connection; r++) {
+                for (size_t i = 0; i < fds.size(); i++) {
+                    sent[i] = chrono::steady_clock::now();
+                    send(fds[i], request.data(), request.size(), MSG_NOSIGNAL);
+                }
+                for (size_t i = 0; i < fds.size(); i++) {
+                    if (!readResponse(fds[i], buffers[i])) errors[t]++;
+                    latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent[i]).count());
+                }
+            }
+            for (int fd : fds) close(fd);
+        });
+        LoadReport report;
+        report.unit = "requests";
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        vector<double> all;
+        for (int t = 0; t < threads; t++) {
+            all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+            report.errors += errors[t];
+        }
+        report.sessions = connections;
+        report.summarize(all);
+        return report;
     }
 };
 
-class eWalletPayment : public PaymentMethod{
+// -------------------- Branch Shards --------------------
+// One process serves every branch of the chain. A branch's state (menu,
+// combos, orders, reservations, payments, staff login, notifications) lives
+// in its BranchShard and is only touched by that shard's worker thread, which
+// is pinned to a core. Callers hand work to a shard with run() and get a
+// future back, so shard state needs no locks. Each shard also has its own
+// payment pipeline, idempotency index and audit log. Items sold at every
+// branch come from the ChainCatalog, an immutable snapshot that all shards
+// read without locking.
+// Still shared between branches: the object slabs (orders, payments,
+// reservations, foods), ingredient stock in the inventory and the payment
+// gateway itself. Those take their own locks, so branches contend only there.
+class ChainCatalog {
 private:
-    string wallet_name;
+    using Items = map<string, Food*, less<>>;
+    shared_ptr<const Items> items = make_shared<const Items>();
+    mutex publish_lock;
+    vector<Food*> owned;
+
 public:
-    eWalletPayment(double _amount, string _wallet_name) : PaymentMethod("e-Wallet", _amount){
-        wallet_name = _wallet_name;
+    ~ChainCatalog() {
+        for (Food* food : owned) freeFood(food);
     }
-    string getWalletName(){return wallet_name;}
-    void setWalletName(string _wallet){wallet_name = _wallet;}
-    void display() override{
-        cout << "Payment via e-Wallet" << endl;
-        cout << "Amount: " << fixed << setprecision(2) << getAmount() << endl;
-        cout << "Wallet Name: " << getWalletName() << endl;
-        cout << "====================" << endl;
+
+    // publishes a new snapshot with the foods added; the catalog owns them
+    void add(const vector<Food*>& foods) {
+        lock_guard<mutex> lock(publish_lock);
+        shared_ptr<Items> next = make_shared<Items>(*atomic_load(&items));
+        for (Food* food : foods) {
+            (*next)[food->getId()] = food;
+            owned.push_back(food);
+        }
+        atomic_store(&items, shared_ptr<const Items>(next));
+    }
+
+    shared_ptr<const Items> snapshot() const { return atomic_load(&items); }
+
+    Food* find(string_view id) const {
+        shared_ptr<const Items> current = snapshot();
+        auto it = current->find(id);
+        return it != current->end() ? it->second : nullptr;
     }
 };
 
-class PaymentManager {
+class BranchShard {
 private:
-    vector<PaymentMethod*> payments;
-public:
-    void addPayment(PaymentMethod* payment) {
-        if (payment != nullptr) {
-            payments.push_back(payment);
+    struct PendingPayment {
+        Order* order;
+        PaymentMethod* payment;
+        shared_future<PaymentResult> result;
+    };
+
+    string branch_id;
+    ChainCatalog& catalog;
+    AccountManager accounts;            // the branch's guests and its own staff login
+    NotificationManager notifications;
+    PaymentManager payments;
+    IdempotencyIndex idempotency{1 << 14, chrono::minutes(30)};
+    PaymentPipeline pipeline{mockGateway, 64, chrono::milliseconds(500), 2, 1};
+    AuditLog audit{1 << 12};
+    map<string, Food*, less<>> foods;   // branch-only items
+    map<string, Combo*, less<>> combos;
+    unordered_map<string, Order*> orders;
+    vector<Reservation*> reservations;
+    vector<PendingPayment> pending;
+
+    mutex queue_lock;
+    condition_variable queue_ready;
+    deque<function<void()>> queue;
+    bool stopping = false;
+    thread worker;
+
+    void settlePayments(bool wait) {
+        for (size_t i = 0; i < pending.size();) {
+            PendingPayment& p = pending[i];
+            if (!wait && p.result.wait_for(chrono::seconds(0)) != future_status::ready) {
+                i++;
+                continue;
+            }
+            PaymentResult result = p.result.get();
+            if (result.status == PaymentStatus::Approved) {
+                p.payment->releaseCard();
+                p.order->markPaid(p.payment);
+                payments.addPayment(p.payment, p.order->getOrderId(), p.order->getTotalPrice());
+            } else {
+                if (p.order->getPaymentMethod() == p.payment) p.order->setPaymentMethod(nullptr);
+                closePaymentAttempt(*p.order, result.status, idempotency);
+                paymentSlab.destroy(p.payment);
+            }
+            pending[i] = pending.back();
+            pending.pop_back();
         }
     }
 
-    void displayAllPayments() {
-        cout << "=== All Payments ===" << endl;
-        for (PaymentMethod* payment : payments) {
-            payment->display();
+    void loop(unsigned core) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);   // best effort
+
+        deque<function<void()>> batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queue_lock);
+                auto wake = [&]() { return stopping || !queue.empty(); };
+                if (pending.empty()) queue_ready.wait(lock, wake);
+                else queue_ready.wait_for(lock, chrono::milliseconds(5), wake);
+                if (stopping && queue.empty()) return;
+                batch.swap(queue);
+            }
+            for (auto& task : batch) task();
+            batch.clear();
+            settlePayments(false);
         }
     }
-};
-PaymentManager paymentManager;
 
-enum class OrderStatus { Pending, Preparing, Completed, Cancelled };
-// -------------------- Reservation --------------------
-class Reservation {
-    private:
-    string reservation_id;
-    User* customer;
-    string date;
-    string time;
-    int party_size;
-    string status;
-    inline static int reservation_cnt = 0;
 public:
-    Reservation(User* _customer, string _date, string _time, int _party_size) : customer(_customer), date(_date), time(_time), party_size(_party_size),status("Pending") {
-        reservation_cnt++;
-        stringstream ss;
-        ss << "R" << setw(3) << setfill('0') << reservation_cnt;
-        reservation_id = ss.str();
-        notificationManager.sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Confirmed", "Reservation " + reservation_id + " for " + to_string(party_size) + " people on " + date + " at " + _time + " is pending confirmation.");
+    BranchShard(string _branch_id, ChainCatalog& _catalog, unsigned core)
+        : branch_id(_branch_id), catalog(_catalog) {
+        worker = thread([this, core]() { loop(core); });
     }
-    void setStatus(string s){
-        status = s;
-        if (s == "Confirmed") {
-            notificationManager.sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Confirmed", "Reservation " + reservation_id + " is confirmed.");
-        } else if (s == "Cancelled") {
-            notificationManager.sendNotification(NotificationType::ORDER_CONFIRMED, "Reservation Cancelled", "Reservation " + reservation_id + " is cancelled.");
+
+    ~BranchShard() {
+        {
+            lock_guard<mutex> lock(queue_lock);
+            stopping = true;
         }
+        queue_ready.notify_one();
+        worker.join();
+        settlePayments(true);
+        for (auto& pair : orders) orderSlab.destroy(pair.second);
+        for (Reservation* reservation : reservations) reservationSlab.destroy(reservation);
+        for (auto& pair : combos) comboSlab.destroy(pair.second);
+        for (auto& pair : foods) freeFood(pair.second);
     }
-    string getReservationID(){
-        return reservation_id;
+
+    // runs fn(shard) on the shard's thread
+    template <typename Fn>
+    auto run(Fn fn) -> future<decltype(fn(*this))> {
+        auto task = make_shared<packaged_task<decltype(fn(*this))()>>([this, fn]() mutable { return fn(*this); });
+        future<decltype(fn(*this))> result = task->get_future();
+        {
+            lock_guard<mutex> lock(queue_lock);
+            queue.push_back([task]() { (*task)(); });
+        }
+        queue_ready.notify_one();
+        return result;
     }
-    string getStatus(){
-        return status;
+
+    // Everything below must be called from the shard's thread, through run().
+    // Foods and combos added here belong to the shard; one whose id is already
+    // on the branch menu is refused and stays with the caller.
+    bool addFood(Food* food) {
+        return food != nullptr && foods.emplace(food->getId(), food).second;
     }
-    string getDate(){
-        return date;
+
+    bool addCombo(Combo* combo) {
+        return combo != nullptr && combos.emplace(combo->getComboId(), combo).second;
     }
-    string getTime(){
-        return time;
+
+    // branch items first, then the chain catalog
+    Food* findFood(string_view id) {
+        auto it = foods.find(id);
+        return it != foods.end() ? it->second : catalog.find(id);
     }
-    User* getCustomer(){
-        return customer;
+
+    Combo* findCombo(string_view id) {
+        auto it = combos.find(id);
+        return it != combos.end() ? it->second : nullptr;
     }
-    void displayInfo(){
-        cout << "=== Reservation Details ===" << endl;
-        cout << "Reservation ID: " << reservation_id << endl;
-        if (customer) {
-            cout<< "Customer: " << customer->getUsername() << " ( ID: " << customer->getId() << " )" << endl;
-        }
-        cout<<"Date: "<<date<<endl;
-        cout<<"Time: "<<time<<endl;
-        cout<<"Party Size: "<<party_size<<endl;
-        cout<<"Status: "<<status<<endl;
-        cout<< "==========================" <<endl;
+
+    Order* findOrder(const string& order_id) {
+        auto it = orders.find(order_id);
+        return it != orders.end() ? it->second : nullptr;
     }
-};
-// -------------------- Order --------------------
-class Order {
-private:
-    string order_id;
-    User* customer;
-    vector<Food*> food_items;
-    vector<Combo> combos;
-    double total_price;
-    OrderStatus status;
-    PaymentMethod* payment;
-    inline static int order_cnt = 0;
 
-    void calculateTotal() {
-        double total = 0.0;
-        for (Food* food : food_items) {
-            total += food->getPrice();
-        }
-        for (Combo& combo : combos) {
-            total += combo.getPrice();
-        }
-        total_price = total;
+    // nullptr unless the guest is registered at this branch
+    Order* createOrder(const string& username, const string& password) {
+        User* user = accounts.authenticate(username, password);
+        if (user == nullptr || user->getRole() != "Guest") return nullptr;
+        Order* order = orderSlab.make<Order>(user, notifications);
+        orders[order->getOrderId()] = order;
+        return order;
     }
 
-public:
-    Order(User* _customer) : customer(_customer), payment(nullptr) {
-        order_cnt++;
-        stringstream ss;
-        ss << "O" << setw(3) << setfill('0') << order_cnt;
-        order_id = ss.str();
-        total_price = 0.0;
-        status = OrderStatus::Pending; // mặc định
-        notificationManager.sendOrderUpdate(order_id, "Confirmed"); //confirmation notification
+    bool addToOrder(const string& order_id, string_view food_id, int quantity = 1) {
+        Order* order = findOrder(order_id);
+        Food* food = findFood(food_id);
+        if (order == nullptr || food == nullptr || order->isPaid()) return false;
+        return order->addFood(food, quantity);
     }
 
-    void setStatus(OrderStatus s) { //updated status based on status change
-         status = s;
-         switch(s) { 
-            case OrderStatus::Preparing:
-                notificationManager.sendOrderUpdate(order_id, "Preparing");
-                break;
-            case OrderStatus::Completed:
-                notificationManager.sendOrderUpdate(order_id, "Ready");
-                break;
-            case OrderStatus::Cancelled:
-                if(payment != nullptr) {
-                    cout << "Refunding $" << fixed << setprecision(2) << payment->getAmount() << " to customer." << endl;
-                }
-            default:
-                break;
-        }
+    bool addComboToOrder(const string& order_id, string_view combo_id) {
+        Order* order = findOrder(order_id);
+        Combo* combo = findCombo(combo_id);
+        return order != nullptr && combo != nullptr && !order->isPaid() && order->addCombo(*combo);
     }
-    void setPaymentMethod(PaymentMethod* pm){payment = pm;}
-    double getTotalPrice() { return total_price; }
-    OrderStatus getStatus() { return status; }
-    string getOrderId() { return order_id; }
-    User* getCustomer() { return customer; }
-    PaymentMethod* getPaymentMethod() { return payment; }
 
-    void addFood(Food* food) {
-        if (food != nullptr) {
-            food_items.push_back(food);
-            calculateTotal();
+    // the change, or -1 if the payment was refused
+    double payCash(const string& order_id, double cash, const string& currency) {
+        Order* order = findOrder(order_id);
+        if (order == nullptr || order->isPaid() || cash < order->getTotalPrice()) return -1;
+        if (acceptCashPayment(*order, idempotency).duplicate) return -1;
+        PaymentMethod* payment = paymentSlab.make<CashPayment>(cash, currency);
+        order->markPaid(payment);
+        payments.addPayment(payment, order->getOrderId(), order->getTotalPrice());
+        return cash - order->getTotalPrice();
+    }
+
+    // submitted to the gateway; the order is marked paid when it approves
+    bool payCard(const string& order_id, const string& card_number) {
+        Order* order = findOrder(order_id);
+        if (order == nullptr || order->isPaid() || card_number.size() != 16) return false;
+        PaymentMethod* payment = paymentSlab.make<CreditPayment>(order->getTotalPrice(), card_number);
+        PaymentSubmission sub = authorizePayment(*order, payment, idempotency, pipeline);
+        if (sub.invalid || sub.duplicate) {
+            paymentSlab.destroy(payment);
+            return false;
         }
+        order->setPaymentMethod(payment);
+        pending.push_back({order, payment, sub.result});
+        return true;
     }
 
-    void addCombo(Combo combo) {
-        combos.push_back(combo);
-        calculateTotal();
+    Reservation* reserve(const string& username, const string& password, const string& date, const string& time_of_day, int party_size) {
+        User* user = accounts.authenticate(username, password);
+        if (user == nullptr) return nullptr;
+        Reservation* reservation = reservationSlab.make<Reservation>(user, date, time_of_day, party_size, notifications);
+        reservations.push_back(reservation);
+        return reservation;
     }
 
-    void display() {
-        cout << "=== Order Details ===" << endl;
-        cout << "Order ID: " << order_id << endl;
-        if (customer) {
-            cout << "Customer: " << customer->getUsername() 
-                 << " (" << customer->getId() << ")" << endl;
-        }
-        cout << "Status: ";
-        switch (status) {
-            case OrderStatus::Pending: cout << "Pending"; break;
-            case OrderStatus::Preparing: cout << "Preparing"; break;
-            case OrderStatus::Completed: cout << "Completed"; break;
-            case OrderStatus::Cancelled: cout << "Cancelled"; break;
-        }
-        cout << endl;
+    bool setOrderStatus(const string& staff_user, const string& staff_password, const string& order_id, OrderStatus status) {
+        User* user = accounts.authenticate(staff_user, staff_password);
+        Order* order = findOrder(order_id);
+        if (!staffCan(user, PERM_UPDATE_ORDER) || order == nullptr) return false;
+        int before = (int)order->getStatus();
+        if (!order->setStatus(status)) return false;
+        audit.record(user->getUsername(), AuditAction::OrderStatus, order_id, before, (int)status);
+        return true;
+    }
 
-        cout << "Items in order:" << endl;
-        for (Food* food : food_items) {
-            cout << "  - ";
-            food->display();
-        }
-        for (Combo& combo : combos) {
-            cout << "  - Combo: " << combo.getComboName() << endl;
-            combo.display();
-        }
-        cout << "Total Price: $" << fixed << setprecision(2) << total_price << endl;
+    string getBranchId() { return branch_id; }
+    AuditLog& getAuditLog() { return audit; }
+    AccountManager& getAccounts() { return accounts; }
+    NotificationManager& getNotifications() { return notifications; }
+    PaymentManager& getPayments() { return payments; }
+    size_t getOrderCount() { return orders.size(); }
+    size_t getReservationCount() { return reservations.size(); }
+    size_t getPendingPaymentCount() { return pending.size(); }
+};
 
-        if(payment){
-            cout << "Payment Details: " << endl;
-            payment->display();
-        } else {
-            cout << "Payment Method: Not set" << endl;
-        }
-        cout << "=====================" << endl;
+// Branches are added at startup; lookups afterwards are read-only.
+class BranchRouter {
+private:
+    ChainCatalog catalog;
+    vector<unique_ptr<BranchShard>> shards;
+    unordered_map<string, BranchShard*> by_id;
+
+public:
+    BranchShard& addBranch(const string& branch_id) {
+        unsigned cores = max(1u, thread::hardware_concurrency());
+        shards.emplace_back(new BranchShard(branch_id, catalog, (unsigned)shards.size() % cores));
+        by_id[branch_id] = shards.back().get();
+        return *shards.back();
+    }
+
+    BranchShard* branch(const string& branch_id) {
+        auto it = by_id.find(branch_id);
+        return it != by_id.end() ? it->second : nullptr;
+    }
+
+    ChainCatalog& getCatalog() { return catalog; }
+    size_t getBranchCount() { return shards.size(); }
+    vector<BranchShard*> getBranches() {
+        vector<BranchShard*> all;
+        for (auto& shard : shards) all.push_back(shard.get());
+        return all;
     }
 };
 
-void Guest_option(User* guest, Order& order,vector<Reservation*>& reservations) {
-    /*updated menu
-    implemented reservation (choice =8 -> 10)*/
-    int choice;
-    do {
-        cout << "\n--- Guest Menu ---\n";
-int unread = notificationManager.getUnreadCount();
-        if (unread > 0) {
-            cout << " [" << unread << " unread notifications]";
-        }
-        cout << "\n";
-        cout << "1. Show Menu\n";
-        cout << "2. Show Order\n";
-        cout << "3. Cancel Order (Pending only)\n";
-        cout << "4. View Notifications\n";
-        cout << "5. View Unread Notifications\n";
-        cout << "6. Notification Settings\n";
-        cout << "7. Payment Menu\n";
-        cout << "8. Make a Reservation\n";
-        cout << "9. View Reservations\n";
-        cout << "10. Cancel Reservation\n";
-        cout << "0. Exit\n";
-        cout << "Choose: ";
-        cin >> choice;
+// kiosk server mode: every client on the socket gets a login prompt
+int serveSessions(const string& path) {
+    AccountManager accounts;
+    accounts.registerGuest("Alice", "pass123");
+    accounts.registerGuest("Bob", "abc123");
+    vector<Order*> orders;
+    vector<Reservation*> reservations;
+    auditLog.open("restaurant");
+    SessionEngine engine([&]() { return unique_ptr<Session>(new LoginSession(accounts, orders, reservations)); });
+    if (!engine.listenUnix(path)) {
+        cerr << "Cannot listen on " << path << endl;
+        return 1;
+    }
+    cout << "Serving sessions on " << path << endl;
+    engine.run();
+    return 0;
+}
 
-        if (choice == 1) {
-            displayAllFood();
-        } else if (choice == 2) {
-            order.display();
-        } else if (choice == 3) {
-            if (order.getStatus() == OrderStatus::Pending) {
-                order.setStatus(OrderStatus::Cancelled);
-                cout << "Order cancelled!\n";
-            } else {
-                cout << "Cannot cancel order (not Pending).\n";
-            }
-        } else if (choice == 4) {
-            notificationManager.showAllNotifications();
-        } else if (choice == 5) {
-            notificationManager.showUnreadNotifications();
-        } else if (choice == 6) {
-            cout << "1. Enable notifications\n2. Disable notifications\nChoose: ";
-            int notif_choice;
-            cin >> notif_choice;
-            if (notif_choice == 1) {
-                notificationManager.enablePushNotifications();
-            } else if (notif_choice == 2) {
-                notificationManager.disablePushNotifications();
-            }
-        } else if (choice == 7) {
-            cout << "\n--- Payment Menu ---\n";
-            cout << "1. Cash\n";
-            cout << "2. Credit Card" << endl;
-            cout << "3. e-Wallet" << endl;
-            cout << "Choose payment method: ";
-            int pChoice; cin >> pChoice;; cin.ignore();
-            PaymentMethod *payment = nullptr;
-
-            if(pChoice == 1){
-                double cash;
-                string currency;
-                cout << "Enter currency (e.g., USD, VND): "; getline(cin, currency);
-                cout << "Enter cash amount: $"; cin >> cash;
-                if(cash < order.getTotalPrice()) cout << "Not enough cash!" << endl;
-                else {
-                    payment = new CashPayment(cash,currency);
-                    cout << "Payment successful!" << endl;
-                    cout << "Change: $" << cash - order.getTotalPrice() << endl;
-                    order.setPaymentMethod(payment);
-                    paymentManager.addPayment(payment);
-                }
-            } 
-            else if (pChoice == 2){
-                string card;
-                cout << "Enter 16-digit card number: "; cin >> card;
-                if(card.size() != 16) cout << "Invalid card number!" << endl;
-                else {
-                    payment = new CreditPayment(order.getTotalPrice(), card);
-                    cout << "Payment successful via Credit Card!" << endl;
-                    order.setPaymentMethod(payment);
-                    paymentManager.addPayment(payment);
-                }
-            }
-            else if (pChoice == 3){
-                string wallet;
-                cout << "Enter e-Wallet name (e.g., PayPal, Momo): "; getline(cin, wallet);
-                payment = new eWalletPayment(order.getTotalPrice(), wallet);
-                cout << "Payment successful via e-Wallet! (" << wallet << ")"<< endl;
-                order.setPaymentMethod(payment);
-                paymentManager.addPayment(payment);
-            } 
-            if (payment != nullptr) {
-                order.setPaymentMethod(payment);
-            }
-        } else if (choice == 8) {
-            cin.ignore();
-            string date,time;
-            int party_size;
-            cout <<"Enter date (YYYY-MM-DD): "; getline(cin, date);
-            cout <<"Enter time (HH:MM): "; getline(cin, time);
-            cout <<"Enter party size: "; cin >> party_size;
-            Reservation* newRes = new Reservation(guest, date, time, party_size);
-            reservations.push_back(newRes);
-            cout<<"Reservation created, waiting to confirm"<<endl;
-            newRes->displayInfo();
-        } else if (choice == 9) {
-            cout << "\n=== Your Reservations ===\n";
-            bool hasReservations = false;
-            for (Reservation* res : reservations) {
-                if (res->getCustomer() == guest) {
-                    res->displayInfo();
-                    hasReservations = true;
-                }
-            }
-            if (!hasReservations) {
-                cout << "No reservations found." << endl;
-            }
-        } else if (choice == 10){
-            string res_id;
-            cout << "Enter Reservation ID to cancel: ";
-            cin>>res_id;
-            for(Reservation* res : reservations){
-                if(res->getReservationID() == res_id && res->getCustomer() ==guest){
-                    if(res->getStatus() == "Pending" || res->getStatus() == "Confirmed"){
-                        res->setStatus("Cancelled");
-                        cout << "Reservation cancelled." << endl;
-                    } else {
-                        cout << "Cannot cancel this reservation." << endl;
-                    }
-                    break;
-                }
-            }
-        }
-    } while (choice != 0);
+// scripted ordering flow against the line protocol: <sessions> guests in parallel
+int runLoadTest(int sessions) {
+    AccountManager accounts;
+    accounts.registerGuest("Alice", "pass123");
+    Food* food = foodSlab.make<ramen>("Tonkotsu Ramen", 12.50);
+    Food* drink = foodSlab.make<Drink>("Coca-Cola", 2.50, "12 oz");
+    addToManageFood(food);
+    addToManageFood(drink);
+    ProtocolContext context(accounts);
+    vector<string> script = {
+        "LOGIN Alice pass123", "ADD " + food->getId() + " 2", "ADD " + drink->getId(), "ORDER",
+        "RESERVE 2026-01-01 19:00 2", "PAY CASH 100 USD", "QUIT"};
+    LoadGenerator generator;
+    LoadReport report = generator.run([&]() { return unique_ptr<Session>(new ProtocolSession(context)); },
+                                      sessions, max(1u, thread::hardware_concurrency()), script);
+    report.display();
+    return report.errors == 0 ? 0 : 1;
 }
 
-void Admin_option(vector<Order*>& orders, vector<Reservation*>& reservations) {
-    int choice;
-    do {
-        cout << "\n--- Admin Menu ---\n";
-        cout << "1. Show all food\n";
-        cout << "2. Show all orders\n";
-        cout << "3. Update order status\n";
-        cout << "4. View all reservations\n";
-        cout << "5. Confirm/Update reservation\n";
-        cout << "6. Send promotion\n";
-        cout << "7. Show Payment History\n";
-        cout << "0. Exit\n";
-        cout << "Choose: ";
-        cin >> choice;
+// HTTP mode: port 0 picks a free port, or "bench" measures GET /menu over loopback
+int serveHttp(const string& port_arg) {
+    AccountManager accounts;
+    accounts.registerGuest("Alice", "pass123");
+    accounts.registerGuest("Bob", "abc123");
+    addToManageFood(foodSlab.make<ramen>("Tonkotsu Ramen", 12.50));
+    addToManageFood(foodSlab.make<rice_don>("Chicken Katsu Don", 10.00));
+    addToManageFood(foodSlab.make<Drink>("Coca-Cola", 2.50, "12 oz"));
+    HttpApi api(accounts);
+    HttpServer server([&](const HttpRequest& request, HttpResponse& response) { api.handle(request, response); });
+    bool bench = port_arg == "bench";
+    if (!server.listenLoopback(bench ? 0 : atoi(port_arg.c_str()))) {
+        cerr << "Cannot listen on port " << port_arg << endl;
+        return 1;
+    }
+    unsigned cores = max(2u, thread::hardware_concurrency());
+    server.start(cores / 2);
+    if (!bench) {
+        cout << "Serving HTTP on 127.0.0.1:" << server.getPort() << endl;
+        while (true) this_thread::sleep_for(chrono::hours(1));
+    }
+    HttpBenchmark benchmark;
+    LoadReport report = benchmark.run(server.getPort(), "GET /menu HTTP/1.1\r\nHost: localhost\r\n\r\n", 64, max(1u, cores / 2), 2000);
+    report.display();
+    return report.errors == 0 ? 0 : 1;
+}
 
-        if (choice == 1) {
-            displayAllFood();
-        } else if (choice == 2) {
-            for (Order* o : orders) {
-                o->display();
-            }
-        } else if (choice == 3) {
-            string oid;
-            cout << "Enter Order ID: ";
-            cin >> oid;
-            for (Order* o : orders) {
-                if (o->getOrderId() == oid) {
-                    int s;
-                    cout << "Choose status (0=Pending,1=Preparing,2=Completed,3=Cancelled): ";
-                    cin >> s;
-                    o->setStatus(static_cast<OrderStatus>(s));
-                    cout << "Order " << oid << " status updated!\n";
-                }
-            }
-        } else if (choice == 4) {
-            cout << "\n=== All Reservations ===\n";
-            if (reservations.empty()) {
-                cout << "No reservations found.\n";
-            } else {
-                for (Reservation* res : reservations) {
-                    res->displayInfo();
-                }
-            }
-        } else if (choice == 5) {
-            string res_id;
-            cout << "Enter Reservation ID: ";
-            cin >> res_id;
-            for (Reservation* res : reservations) {
-                if (res->getReservationID() == res_id) {
-                    cout << "Choose status:\n";
-                    cout << "1. Pending\n2. Confirmed\n3. Cancelled\n4. Completed\n";
-                    cout << "Choose: ";
-                    int s;
-                    cin >> s;
-                    string status;
-                    if (s == 1) status = "Pending";
-                    else if (s == 2) status = "Confirmed";
-                    else if (s == 3) status = "Cancelled";
-                    else if (s == 4) status = "Completed";
-                    
-                    res->setStatus(status);
-                    cout << "Reservation " << res_id << " status updated to " << status << "!\n";
-                    break;
-                }
-            }
-        } else if (choice == 6) {
-            cin.ignore();
-            string promo;
-            cout << "Enter promotion message: ";
-            getline(cin, promo);
-            notificationManager.sendPromotion(promo);
-        } else if (choice == 7) {
-            paymentManager.displayAllPayments();
+// prints the admin actions recorded under <prefix>; "-" matches anything
+int queryAudit(int argc, char** argv) {
+    AuditQuery query;
+    if (argc > 3 && string(argv[3]) != "-") query.actor = argv[3];
+    if (argc > 4 && string(argv[4]) != "-") {
+        for (int a = 1; a <= 5; a++) {
+            if (argv[4] == string(auditActionName(static_cast<AuditAction>(a)))) query.action = static_cast<AuditAction>(a);
         }
-    } while (choice != 0);
+        if (query.action == AuditAction{}) {
+            cerr << "Unknown action " << argv[4] << endl;
+            return 1;
+        }
+    }
+    if (argc > 5) query.target = argv[5];
+    auditLog.openReadOnly(argv[2]);
+    auto start = chrono::steady_clock::now();
+    string out;
+    stringstream line;
+    size_t matches = auditLog.scan(query, [&](const AuditRecord& r) {
+        line.str("");
+        r.display(line);
+        out += line.str();
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << out << matches << " of " << auditLog.getRecordCount() << " records matched in "
+         << fixed << setprecision(3) << seconds * 1000 << " ms" << endl;
+    return 0;
 }
 
-
 // -------------------- main --------------------
-int main() {
+int main(int argc, char** argv) {
+    if (argc == 3 && string(argv[1]) == "--serve") return serveSessions(argv[2]);
+    if (argc == 3 && string(argv[1]) == "--loadtest") return runLoadTest(atoi(argv[2]));
+    if (argc == 3 && string(argv[1]) == "--http") return serveHttp(argv[2]);
+    if (argc >= 3 && argc <= 6 && string(argv[1]) == "--audit") return queryAudit(argc, argv);
+
     cout << "===== Restaurant Ordering System Demo =====\n\n";
 
     // Initialize account manager and create sample accounts
@@ -986,9 +7593,9 @@ int main() {
     }
 
     // ===== Create some food items and combos =====
-    Food* ramen1 = new ramen("Tonkotsu Ramen", 12.50);
-    Food* don1 = new rice_don("Chicken Katsu Don", 10.00);
-    Food* drink1 = new Drink("Coca-Cola", 2.50, "12 oz");
+    Food* ramen1 = foodSlab.make<ramen>("Tonkotsu Ramen", 12.50);
+    Food* don1 = foodSlab.make<rice_don>("Chicken Katsu Don", 10.00);
+    Food* drink1 = foodSlab.make<Drink>("Coca-Cola", 2.50, "12 oz");
 
     addToManageFood(ramen1);
     addToManageFood(don1);
@@ -996,34 +7603,38 @@ int main() {
     displayAllFood();
     cout << endl;
 
-    Combo lunchCombo("Lunch Combo", 0.1);
-    lunchCombo.addFood(ramen1);
-    lunchCombo.addFood(drink1);
-    lunchCombo.display();
+    Combo* lunchCombo = comboSlab.make<Combo>("Lunch Combo", 0.1);
+    lunchCombo->addFood(ramen1);
+    lunchCombo->addFood(drink1);
+    lunchCombo->display();
+    comboManager.addCombo(lunchCombo);
     cout << endl;
 
     // ===== Alice creates a new order =====
-    Order order1(alice);
-    order1.addFood(don1);
-    order1.addCombo(lunchCombo);
-    cout << "Order created successfully!\n";
-    order1.display();
+    Order* order1 = orderSlab.make<Order>(alice);
+    order1->addFood(don1);
+    order1->addFood(ramen1);
+    order1->addFood(drink1);
+    int applied = order1->applyBestCombos(comboManager.getAllCombos());
+    cout << "Order created successfully! (" << applied << " combo applied)\n";
+    order1->display();
     cout << endl;
 
     // ===== Payment Process =====
     cout << "--- Payment Menu ---\n";
-    PaymentMethod* pay1 = new eWalletPayment(order1.getTotalPrice(), "Momo");
-    order1.setPaymentMethod(pay1);
-    paymentManager.addPayment(pay1);
-    cout << "Payment successful using e-Wallet (Momo)!\n\n";
+    PaymentMethod* pay1 = paymentSlab.make<eWalletPayment>(order1->getTotalPrice(), "Momo");
+    order1->setPaymentMethod(pay1);
+    cout << "Authorizing e-Wallet (Momo) payment...\n";
+    applyPaymentResult(*order1, pay1, authorizePayment(*order1, pay1).result.get());
+    cout << endl;
 
     // ===== Display updated order with payment =====
-    order1.display();
+    order1->display();
     cout << endl;
 
     // ===== Order Cancellation (Refund) =====
     cout << "--- Cancelling Order ---\n";
-    order1.setStatus(OrderStatus::Cancelled);
+    order1->setStatus(OrderStatus::Cancelled);
     cout << "Order cancelled successfully. Refund processed.\n\n";
 
     // ===== Staff Login =====
@@ -1035,16 +7646,13 @@ int main() {
 
     // ===== Staff views payment history =====
     paymentManager.displayAllPayments();
+    paymentManager.displayTodayRevenue();
 
     cout << "\n===== Demo Complete =====\n";
 
-    // Cleanup
+    // Cleanup (menu, combo, order and payment objects are owned by their slabs)
     delete alice;
     delete staff;
-    delete ramen1;
-    delete don1;
-    delete drink1;
-    delete pay1;
 
     return 0;
 }